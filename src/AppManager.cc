@@ -22,6 +22,8 @@
 #include <algorithm>
 #include <stdlib.h>
 #include <system_error>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "CMDLineAssembler.hh"
 
@@ -72,8 +74,10 @@ bool validate_desktop_file_list(const Desktop_file_list &files) {
 #endif
 
 AppManager::AppManager(Desktop_file_list files, stringlist_t desktopenvs,
-                       LocaleSuffixes suffixes, ParsingQuirks quirks)
-    : suffixes(std::move(suffixes)), desktopenvs(desktopenvs) {
+                       LocaleSuffixes suffixes, ParsingQuirks quirks,
+                       ParsingLimits limits, DesktopFileUse use)
+    : suffixes(std::move(suffixes)), desktopenvs(desktopenvs), limits(limits),
+      use(use) {
     SPDLOG_DEBUG("AppManager: Entered AppManager");
 #ifdef DEBUG
     if (!validate_desktop_file_list(files)) {
@@ -101,7 +105,8 @@ AppManager::AppManager(Desktop_file_list files, stringlist_t desktopenvs,
             try {
                 auto try_add = this->applications.try_emplace(
                     desktop_file_ID, rank, in_place_t{}, filename.c_str(),
-                    this->liner, this->suffixes, this->desktopenvs);
+                    this->liner, this->suffixes, this->desktopenvs,
+                    this->limits, this->use);
 
                 // Handle desktop file ID collision.
                 if (!try_add.second) {
@@ -132,6 +137,14 @@ AppManager::AppManager(Desktop_file_list files, stringlist_t desktopenvs,
                     }
                 }
 
+                add_mime_mapping(desktop_file_ID, *newly_added.app);
+
+                if (newly_added.app->no_display) {
+                    SPDLOG_DEBUG("AppManager:     Desktop file has NoDisplay "
+                                 "set, not registering its names.");
+                    continue;
+                }
+
                 // Add the names.
                 auto add_result = this->name_app_mapping.try_emplace(
                     newly_added.app->name, &*newly_added.app, false);
@@ -162,6 +175,12 @@ AppManager::AppManager(Desktop_file_list files, stringlist_t desktopenvs,
             } catch (const std::system_error &e) {
                 SPDLOG_WARN("Couldn't open file '{}': {}", filename, e.what());
                 continue;
+            } catch (const limit_error &e) {
+                SPDLOG_WARN("Desktop file '{}' exceeds parsing limits, "
+                            "skipping: {}",
+                            filename, e.what());
+                ++this->limit_exceeded_count;
+                continue;
             } catch (const invalid_error &e) {
                 SPDLOG_WARN("Desktop file '{}' is invalid: {}", filename,
                             e.what());
@@ -171,6 +190,73 @@ AppManager::AppManager(Desktop_file_list files, stringlist_t desktopenvs,
     }
 }
 
+AppManager::AppManager(StateReader &state, stringlist_t desktopenvs,
+                       LocaleSuffixes suffixes, ParsingLimits limits)
+    : suffixes(std::move(suffixes)), desktopenvs(std::move(desktopenvs)),
+      limits(limits) {
+    int64_t count = state.read_int();
+    if (count < 0)
+        throw state_error("Invalid number of applications.");
+    for (int64_t i = 0; i < count; ++i) {
+        string ID = state.read_string();
+        int rank = state.read_int();
+        if (ID.empty() || rank < 0)
+            throw state_error("Invalid application.");
+
+        bool is_populated = state.read_bool();
+        auto try_add =
+            is_populated
+                ? this->applications.try_emplace(std::move(ID), rank,
+                                                 in_place_t{})
+                : this->applications.try_emplace(std::move(ID), rank);
+        if (!try_add.second)
+            throw state_error("Duplicate desktop file ID.");
+        if (!is_populated)
+            continue;
+
+        // This must be kept in sync with save_state().
+        Application &app = *try_add.first->second.app;
+        app.name = state.read_string();
+        app.generic_name = state.read_string();
+        app.exec = state.read_string();
+        app.path = state.read_string();
+        app.icon = state.read_string();
+        app.location = state.read_string();
+        app.terminal = state.read_bool();
+        app.no_display = state.read_bool();
+        int64_t mime_type_count = state.read_int();
+        if (mime_type_count < 0)
+            throw state_error("Invalid number of MIME types.");
+        for (int64_t j = 0; j < mime_type_count; ++j)
+            app.mime_types.push_back(state.read_string());
+        app.id = state.read_string();
+        if (app.name.empty() || app.exec.empty())
+            throw state_error("Invalid application.");
+        add_mime_mapping(try_add.first->first, app);
+    }
+
+    // Collisions can't be resolved again here, it isn't deterministic which
+    // app wins a name collision in a single rank. The mapping must be restored
+    // as is.
+    count = state.read_int();
+    if (count < 0)
+        throw state_error("Invalid number of names.");
+    for (int64_t i = 0; i < count; ++i) {
+        string ID = state.read_string();
+        bool is_generic = state.read_bool();
+
+        auto iter = this->applications.find(ID);
+        if (iter == this->applications.end() || !iter->second.app ||
+            iter->second.app->no_display)
+            throw state_error("Name is owned by an unknown application.");
+        const Application &app = *iter->second.app;
+        const string &name = is_generic ? app.generic_name : app.name;
+        if (name.empty() ||
+            !this->name_app_mapping.try_emplace(name, &app, is_generic).second)
+            throw state_error("Invalid name.");
+    }
+}
+
 void AppManager::remove(const string &filename, const string &base_path) {
     // Desktop file ID must be relative to $XDG_DATA_DIRS. We need the base
     // path to determine it. Another solution would be to accept a relative
@@ -187,7 +273,7 @@ void AppManager::remove(const string &filename, const string &base_path) {
     }
 
     Managed_application &app = app_iter->second;
-    if (app.app) {
+    if (app.app && !app.app->no_display) {
         remove_name_mapping<NameType::name>(app);
         if (!app.app->generic_name.empty()) {
             // If the desktop app has Name == GenericName, than the first call
@@ -200,6 +286,8 @@ void AppManager::remove(const string &filename, const string &base_path) {
                 remove_name_mapping<NameType::generic_name>(app);
         }
     }
+    if (app.app)
+        remove_mime_mapping(ID, *app.app);
 
     this->applications.erase(app_iter);
 }
@@ -241,7 +329,7 @@ void AppManager::add(const string &filename, const string &base_path,
         std::optional<Application> new_app;
         try {
             new_app.emplace(filename.c_str(), this->liner, this->suffixes,
-                            this->desktopenvs);
+                            this->desktopenvs, this->limits, this->use);
         } catch (const disabled_error &e) {
             SPDLOG_DEBUG("AppManager:     App is disabled: {}", e.what());
             is_disabled = true;
@@ -249,6 +337,12 @@ void AppManager::add(const string &filename, const string &base_path,
             SPDLOG_WARN("Couldn't open newly added desktop file '{}': {}",
                         filename, e.what());
             return;
+        } catch (const limit_error &e) {
+            SPDLOG_WARN("Newly added desktop file '{}' exceeds parsing "
+                        "limits, skipping: {}",
+                        filename, e.what());
+            ++this->limit_exceeded_count;
+            return;
         } catch (const invalid_error &e) {
             SPDLOG_WARN("Newly added desktop file '{}' is invalid: {}",
                         filename, e.what());
@@ -256,18 +350,27 @@ void AppManager::add(const string &filename, const string &base_path,
         }
 
         if (managed_app.app) {
-            remove_name_mapping<NameType::name>(managed_app);
-            if (!managed_app.app->generic_name.empty())
-                remove_name_mapping<NameType::generic_name>(managed_app);
+            if (!managed_app.app->no_display) {
+                remove_name_mapping<NameType::name>(managed_app);
+                // See remove() for explanation of the Name == GenericName
+                // check.
+                if (!managed_app.app->generic_name.empty() &&
+                    managed_app.app->generic_name != managed_app.app->name)
+                    remove_name_mapping<NameType::generic_name>(managed_app);
+            }
+            remove_mime_mapping(ID, *managed_app.app);
         }
 
         managed_app.rank = rank;
         managed_app.app = std::move(new_app);
 
         if (!is_disabled) {
-            replace_name_mapping<NameType::name>(managed_app);
-            if (!managed_app.app->generic_name.empty())
-                replace_name_mapping<NameType::generic_name>(managed_app);
+            if (!managed_app.app->no_display) {
+                replace_name_mapping<NameType::name>(managed_app);
+                if (!managed_app.app->generic_name.empty())
+                    replace_name_mapping<NameType::generic_name>(managed_app);
+            }
+            add_mime_mapping(ID, *managed_app.app);
         }
     } else {
         SPDLOG_DEBUG("AppManager:   File '{}' has no ID collision.", filename);
@@ -276,7 +379,8 @@ void AppManager::add(const string &filename, const string &base_path,
             app_ptr = &this->applications
                            .try_emplace(ID, rank, in_place_t{},
                                         filename.c_str(), this->liner,
-                                        this->suffixes, this->desktopenvs)
+                                        this->suffixes, this->desktopenvs,
+                                        this->limits, this->use)
                            .first->second;
         } catch (const disabled_error &e) {
             SPDLOG_DEBUG("AppManager:     App is disabled: {}", e.what());
@@ -286,6 +390,12 @@ void AppManager::add(const string &filename, const string &base_path,
             SPDLOG_WARN("Couldn't open newly added desktop file '{}': {}",
                         filename, e.what());
             return;
+        } catch (const limit_error &e) {
+            SPDLOG_WARN("Newly added desktop file '{}' exceeds parsing "
+                        "limits, skipping: {}",
+                        filename, e.what());
+            ++this->limit_exceeded_count;
+            return;
         } catch (const invalid_error &e) {
             SPDLOG_WARN("Newly added desktop file '{}' is invalid: {}",
                         filename, e.what());
@@ -296,17 +406,34 @@ void AppManager::add(const string &filename, const string &base_path,
 
         // The new application must be a poppulated one, this function would
         // have returned by now if that wasn't the case.
+        add_mime_mapping(ID, *app.app);
+        if (app.app->no_display)
+            return;
         replace_name_mapping<NameType::name>(app);
         if (!app.app->generic_name.empty())
             replace_name_mapping<NameType::generic_name>(app);
     }
 }
 
+unsigned long AppManager::get_limit_exceeded_count() const {
+    return this->limit_exceeded_count;
+}
+
 const AppManager::name_app_mapping_type &
 AppManager::view_name_app_mapping() const {
     return this->name_app_mapping;
 }
 
+stringlist_t AppManager::list_IDs() const {
+    stringlist_t result;
+    for (const auto &[ID, managed_app] : this->applications) {
+        if (managed_app.app)
+            result.push_back(ID);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
 AppManager::applications_type::size_type AppManager::count() const {
     return this->applications.size();
 }
@@ -338,6 +465,16 @@ void AppManager::check_inner_state() const {
     // desktop_ID.size() is still undefined behavior, but it "fixes"
     // _GLIBCXX_DEBUG errors. All string_views point to std::string
     // which are terminated by \0 so we aren't accessing bad memory.
+    //
+    // All checks must be done in linear time. This function is called after
+    // every change to AppManager in debug builds and it is used by stress
+    // tests. Reverse indexes of applications are constructed first, the
+    // contents of name_app_mapping are then validated against them.
+    std::unordered_set<const char *> known_names;
+    std::unordered_set<const Application *> known_apps;
+    known_names.reserve(this->applications.size() * 2);
+    known_apps.reserve(this->applications.size());
+
     for (const auto &[ID, app] : this->applications) {
         if (ID.empty()) {
             SPDLOG_ERROR("AppManager check error: A managed application in "
@@ -355,6 +492,12 @@ void AppManager::check_inner_state() const {
                          "applications might not have been constructed!");
             abort();
         }
+        // Apps with NoDisplay=true mustn't be referenced by name_app_mapping.
+        if (app.app && !app.app->no_display) {
+            known_names.insert(app.app->name.data());
+            known_names.insert(app.app->generic_name.data());
+            known_apps.insert(&*app.app);
+        }
     }
 
     for (const auto &[name, resolved] : this->name_app_mapping) {
@@ -370,29 +513,95 @@ void AppManager::check_inner_state() const {
                 "likely corrupted!");
             abort();
         }
-        using value_type = decltype(this->applications)::value_type;
-        if (std::find_if(
-                applications.cbegin(), applications.cend(),
-                [&name = name](const value_type &val) {
-                    return val.second.app &&
-                           (val.second.app->name.data() == name.data() ||
-                            val.second.app->generic_name.data() == name.data());
-                }) == applications.cend()) {
+        if (known_names.count(name.data()) == 0) {
             SPDLOG_ERROR(
                 "AppManager check error: A name in name_app_mapping points "
                 "to an unknown location not in applications!");
             abort();
         }
-        if (std::find_if(applications.cbegin(), applications.cend(),
-                         [&ptr = resolved.app](const value_type &val) {
-                             return val.second.app && &*val.second.app == ptr;
-                         }) == applications.cend()) {
+        if (known_apps.count(resolved.app) == 0) {
             SPDLOG_ERROR(
                 "AppManager check error: An managed application pointer in "
                 "name_app_mapping points to an unknown managed application "
                 "not in applications!");
             abort();
         }
+        // The key of name_app_mapping must be owned by the application it
+        // resolves to (see remove_name_mapping()).
+        const string &owned_name =
+            resolved.is_generic ? resolved.app->generic_name
+                                : resolved.app->name;
+        if (owned_name.data() != name.data()) {
+            SPDLOG_ERROR("AppManager check error: A name in name_app_mapping "
+                         "isn't owned by the application it resolves to!");
+            abort();
+        }
+    }
+
+    for (const auto &[mime_type, IDs] : this->mime_app_mapping) {
+        if (IDs.empty()) {
+            SPDLOG_ERROR("AppManager check error: MIME type '{}' in "
+                         "mime_app_mapping has no applications!",
+                         mime_type);
+            abort();
+        }
+        for (const string &ID : IDs) {
+            auto iter = this->applications.find(ID);
+            if (iter == this->applications.end() || !iter->second.app) {
+                SPDLOG_ERROR("AppManager check error: MIME type '{}' in "
+                             "mime_app_mapping refers to an unknown "
+                             "application '{}'!",
+                             mime_type, ID);
+                abort();
+            }
+            // MimeType lists are short, this doesn't break linearity.
+            const stringlist_t &mime_types = iter->second.app->mime_types;
+            if (std::find(mime_types.begin(), mime_types.end(), mime_type) ==
+                mime_types.end()) {
+                SPDLOG_ERROR("AppManager check error: Application '{}' is "
+                             "registered for MIME type '{}' which it doesn't "
+                             "support!",
+                             ID, mime_type);
+                abort();
+            }
+        }
+    }
+}
+
+void AppManager::save_state(StateWriter &state) const {
+    std::unordered_map<const Application *, const string *> IDs;
+    IDs.reserve(this->applications.size());
+
+    state.write_int(this->applications.size());
+    for (const auto &[ID, managed_app] : this->applications) {
+        state.write_string(ID);
+        state.write_int(managed_app.rank);
+        state.write_bool(managed_app.app.has_value());
+        if (!managed_app.app)
+            continue;
+
+        // This must be kept in sync with the state restoring constructor.
+        const Application &app = *managed_app.app;
+        state.write_string(app.name);
+        state.write_string(app.generic_name);
+        state.write_string(app.exec);
+        state.write_string(app.path);
+        state.write_string(app.icon);
+        state.write_string(app.location);
+        state.write_bool(app.terminal);
+        state.write_bool(app.no_display);
+        state.write_int(app.mime_types.size());
+        for (const string &mime_type : app.mime_types)
+            state.write_string(mime_type);
+        state.write_string(app.id);
+
+        IDs.emplace(&app, &ID);
+    }
+
+    state.write_int(this->name_app_mapping.size());
+    for (const auto &[name, resolved] : this->name_app_mapping) {
+        state.write_string(*IDs.at(resolved.app));
+        state.write_bool(resolved.is_generic);
     }
 }
 
@@ -404,3 +613,43 @@ AppManager::lookup_by_ID(const string &ID) const {
     else
         return result->second.app;
 }
+
+stringlist_t AppManager::lookup_by_mime_type(const string &mime_type) const {
+    auto iter = this->mime_app_mapping.find(mime_type);
+    if (iter == this->mime_app_mapping.end())
+        return {};
+
+    std::vector<std::pair<int, const string *>> sorted;
+    sorted.reserve(iter->second.size());
+    for (const string &ID : iter->second)
+        sorted.emplace_back(this->applications.at(ID).rank, &ID);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto &a, const auto &b) {
+                  if (a.first != b.first)
+                      return a.first < b.first;
+                  return *a.second < *b.second;
+              });
+
+    stringlist_t result;
+    result.reserve(sorted.size());
+    for (const auto &[rank, ID] : sorted)
+        result.push_back(*ID);
+    return result;
+}
+
+void AppManager::add_mime_mapping(const string &ID, const Application &app) {
+    for (const string &mime_type : app.mime_types)
+        this->mime_app_mapping[mime_type].insert(ID);
+}
+
+void AppManager::remove_mime_mapping(const string &ID,
+                                     const Application &app) {
+    for (const string &mime_type : app.mime_types) {
+        auto iter = this->mime_app_mapping.find(mime_type);
+        if (iter == this->mime_app_mapping.end())
+            continue;
+        iter->second.erase(ID);
+        if (iter->second.empty())
+            this->mime_app_mapping.erase(iter);
+    }
+}
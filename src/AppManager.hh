@@ -31,13 +31,16 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "Application.hh"
 #include "LineReader.hh"
 #include "LocaleSuffixes.hh"
+#include "ParsingLimits.hh"
 #include "ParsingQuirks.hh"
+#include "StateHandoff.hh"
 #include "Utilities.hh"
 
 using std::string;
@@ -55,6 +58,8 @@ struct Managed_application
     // If app is unoccupied, it means that the app is disabled (using Hidden or
     // OnlyShowIn/NotShowIn), it doesn't provide Name nor GenericName but still
     // participates in desktop ID collision mechanism
+    // Apps with NoDisplay=true are populated (they can be looked up by desktop
+    // ID and MIME type), but they don't provide names either.
     std::optional<Application> app;
     int rank;
 
@@ -94,6 +99,9 @@ class AppManager
 public:
     using name_app_mapping_type =
         std::unordered_map<string_view /*(Generic)Name*/, Resolved_application>;
+    using mime_app_mapping_type =
+        std::unordered_map<string /*MIME type*/,
+                           std::unordered_set<string> /*desktop IDs*/>;
 
     AppManager(const AppManager &) = delete;
     AppManager(AppManager &&) = delete;
@@ -101,23 +109,45 @@ public:
     void operator=(AppManager &&) = delete;
 
     AppManager(Desktop_file_list files, stringlist_t desktopenvs,
-               LocaleSuffixes suffixes, ParsingQuirks quirks = {false, false});
+               LocaleSuffixes suffixes, ParsingQuirks quirks = {false, false},
+               ParsingLimits limits = {},
+               DesktopFileUse use = DesktopFileUse::menu);
+    // Restore state saved by save_state(). This throws state_error.
+    AppManager(StateReader &state, stringlist_t desktopenvs,
+               LocaleSuffixes suffixes, ParsingLimits limits = {});
 
     void remove(const string &filename, const string &base_path);
     // This function accepts path to the desktop file relative to $XDG_DATA_DIRS
     // and its rank within $XDG_DATA_DIRS
     void add(const string &filename, const string &base_path, int rank);
     applications_type::size_type count() const;
+    // Return the number of desktop files which have been skipped because they
+    // exceeded ParsingLimits. This includes files skipped by add(), a desktop
+    // file which has been skipped several times is counted several times.
+    unsigned long get_limit_exceeded_count() const;
     const name_app_mapping_type &view_name_app_mapping() const;
+    // Return desktop IDs of all enabled apps (including NoDisplay ones) in
+    // alphabetical order.
+    stringlist_t list_IDs() const;
 
     // This function should be used only for debugging.
     void check_inner_state() const;
 
-    // This function will never get called in a typical j4dd session. It is used
-    // only for converting the old history format to the new one.
+    // Save state for StateHandoff.
+    void save_state(StateWriter &state) const;
+
+    // Return the app with desktop ID ID. Apps with NoDisplay=true are returned
+    // too, disabled apps aren't. This is used by the --wait-on daemon to handle
+    // launch requests and to resolve handlers of MIME types and when
+    // converting the old history format to the new one.
     std::optional<std::reference_wrapper<const Application>>
     lookup_by_ID(const string &ID) const;
 
+    // Return desktop IDs of apps which list mime_type in their MimeType key.
+    // They are sorted by rank, apps of the same rank are sorted by desktop ID.
+    // See MimeApps.hh for the complete resolution of MIME types.
+    stringlist_t lookup_by_mime_type(const string &mime_type) const;
+
 private:
     enum class NameType { name, generic_name };
 
@@ -167,8 +197,8 @@ private:
             for (auto iter = this->applications.begin();
                  iter != this->applications.end(); ++iter) {
                 Managed_application &managed_app = iter->second;
-                // Skip unpopulated apps
-                if (!managed_app.app)
+                // Skip unpopulated apps and apps which don't provide names
+                if (!managed_app.app || managed_app.app->no_display)
                     continue;
                 Application &app = *managed_app.app;
 
@@ -256,6 +286,11 @@ private:
         }
     }
 
+    // Register/unregister the MIME types of a populated app in
+    // mime_app_mapping.
+    void add_mime_mapping(const string &ID, const Application &app);
+    void remove_mime_mapping(const string &ID, const Application &app);
+
     // This contains the actual data. All other containers depend on this
     // unordered_map. This list should be modified first when adding something
     // and it should be modified last when removing something for lifetime
@@ -263,11 +298,18 @@ private:
     applications_type applications;
     // Map used for lookup and name listing.
     name_app_mapping_type name_app_mapping;
+    // Reverse index of the MimeType keys of applications. Desktop IDs are
+    // used instead of pointers, they are needed for mimeapps.list.
+    mime_app_mapping_type mime_app_mapping;
 
     // Things needed to construct Application:
     LineReader liner;
     LocaleSuffixes suffixes;
     stringlist_t desktopenvs;
+    ParsingLimits limits;
+    DesktopFileUse use = DesktopFileUse::menu;
+
+    unsigned long limit_exceeded_count = 0;
 };
 
 #endif
@@ -19,27 +19,32 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <errno.h>
-#include <memory>
-#include <stdio.h>
+#include <fcntl.h>
 #include <string_view>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <system_error>
+#include <unistd.h>
 #include <utility>
 
 #include "LineReader.hh"
 
 bool Application::operator==(const Application &other) const {
     return name == other.name && generic_name == other.generic_name &&
-           exec == other.exec && path == other.path &&
+           exec == other.exec && path == other.path && icon == other.icon &&
            location == other.location && terminal == other.terminal &&
-           id == other.id;
+           mime_types == other.mime_types &&
+           no_display == other.no_display && id == other.id;
 }
 
 Application::Application(const char *path, LineReader &liner,
                          const LocaleSuffixes &locale_suffixes,
-                         const stringlist_t &desktopenvs) {
+                         const stringlist_t &desktopenvs,
+                         const ParsingLimits &limits, DesktopFileUse use) {
     // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
     // !!   The code below is extremely hacky. But fast.    !!
     // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -52,9 +57,37 @@ Application::Application(const char *path, LineReader &liner,
 
     bool parse_key_values = false;
     ssize_t line_length;
-    std::unique_ptr<FILE, fclose_deleter> file(fopen(path, "r"));
-    if (!file)
+    // O_NONBLOCK prevents blocking on FIFOs. It has no effect on regular
+    // files.
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd == -1)
         throw std::system_error(errno, std::system_category());
+    OnExit close_fd = [fd]() { close(fd); };
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        throw std::system_error(errno, std::system_category());
+    if (!S_ISREG(st.st_mode))
+        throw invalid_error("Desktop file isn't a regular file.");
+
+    using clock = std::chrono::steady_clock;
+    clock::time_point deadline;
+    if (limits.parse_time_budget != 0)
+        deadline = clock::now() +
+                   std::chrono::milliseconds(limits.parse_time_budget);
+
+    // The size is checked twice, the file could grow after fstat().
+    if (limits.max_file_size != 0 &&
+        (unsigned long long)st.st_size > limits.max_file_size)
+        throw limit_error("Desktop file is larger than " +
+                          std::to_string(limits.max_file_size) + " bytes.");
+    ssize_t file_size = liner.read_file(fd, limits.max_file_size);
+    if (file_size == -1)
+        throw std::system_error(errno, std::system_category());
+    if (limits.max_file_size != 0 && (size_t)file_size > limits.max_file_size)
+        throw limit_error("Desktop file is larger than " +
+                          std::to_string(limits.max_file_size) + " bytes.");
+
+    size_t keys_in_group = 0;
 
     // The choice of 'unsigned long' is arbitrary here. This variable isn't
     // checked for integer overflow, but it is unlikely that a desktop file will
@@ -62,15 +95,38 @@ Application::Application(const char *path, LineReader &liner,
     // only, so it doesn't matter much.
     unsigned long line_number = 0;
 
-    while ((line_length = liner.getline(file.get())) != -1) {
+    while ((line_length = liner.next_line()) != -1) {
         ++line_number;
+        if (limits.max_line_length != 0 &&
+            (size_t)line_length > limits.max_line_length)
+            throw limit_error("Line is longer than " +
+                              std::to_string(limits.max_line_length) +
+                              " bytes (line " + std::to_string(line_number) +
+                              ").");
         char *line = liner.get_lineptr();
         line[--line_length] = 0; // Chop off \n
 
+        // Checking the clock for every line would be needlessly slow.
+        if (limits.parse_time_budget != 0 && line_number % 64 == 0 &&
+            clock::now() > deadline)
+            throw limit_error("Parsing took longer than " +
+                              std::to_string(limits.parse_time_budget) +
+                              " ms (line " + std::to_string(line_number) +
+                              ").");
+
         // Blank line or comment
         if (!line_length || line[0] == '#')
             continue;
 
+        if (line[0] == '[')
+            keys_in_group = 0;
+        else if (limits.max_keys_per_group != 0 &&
+                 ++keys_in_group > limits.max_keys_per_group)
+            throw limit_error("Group has more than " +
+                              std::to_string(limits.max_keys_per_group) +
+                              " keys (line " + std::to_string(line_number) +
+                              ").");
+
         if (parse_key_values) {
             // Desktop Entry section ended (b/c another section starts)
             if (line[0] == '[')
@@ -108,6 +164,8 @@ Application::Application(const char *path, LineReader &liner,
                     this->exec = expand("Exec", value);
                 else if (strcmp(key, "Path") == 0)
                     this->path = expand("Path", value);
+                else if (strcmp(key, "Icon") == 0)
+                    this->icon = expand("Icon", value);
                 else if (strcmp(key, "OnlyShowIn") == 0) {
                     if (!desktopenvs.empty()) {
                         stringlist_t values = expandlist("OnlyShowIn", value);
@@ -127,14 +185,30 @@ Application::Application(const char *path, LineReader &liner,
                                 "NotShowIn field matches current desktop.");
                         }
                     }
-                } else if (strcmp(key, "Hidden") == 0 ||
-                           strcmp(key, "NoDisplay") == 0) {
+                } else if (strcmp(key, "Hidden") == 0) {
                     if (strcmp(value, "true") == 0) {
-                        throw disabled_error("Refusing to parse Hidden or "
-                                             "NoDisplay desktop file.");
+                        throw disabled_error(
+                            "Refusing to parse Hidden desktop file.");
+                    }
+                } else if (strcmp(key, "NoDisplay") == 0) {
+                    if (use == DesktopFileUse::menu)
+                        this->no_display = strcmp(value, "true") == 0;
+                } else if (strcmp(key, "X-GNOME-Autostart-enabled") == 0 &&
+                           use == DesktopFileUse::autostart) {
+                    if (strcmp(value, "false") == 0) {
+                        throw disabled_error("Refusing to parse disabled "
+                                             "autostart desktop file.");
                     }
                 } else if (strcmp(key, "Terminal") == 0) {
                     this->terminal = strcmp(value, "true") == 0;
+                } else if (strcmp(key, "MimeType") == 0) {
+                    if (*value != '\0')
+                        this->mime_types = expandlist("MimeType", value);
+                    // Remove empty elements (from "a;;b").
+                    this->mime_types.erase(
+                        std::remove(this->mime_types.begin(),
+                                    this->mime_types.end(), std::string()),
+                        this->mime_types.end());
                 }
             } catch (const escape_error &e) {
                 SPDLOG_ERROR("{}: {}", location, e.what());
@@ -22,6 +22,7 @@
 #include <string>
 
 #include "LocaleSuffixes.hh"
+#include "ParsingLimits.hh"
 #include "Utilities.hh"
 
 class LineReader;
@@ -38,12 +39,23 @@ struct invalid_error : public std::runtime_error
     using std::runtime_error::runtime_error;
 };
 
+// Desktop file exceeds ParsingLimits, parsing was stopped early
+struct limit_error final : public invalid_error
+{
+    using invalid_error::invalid_error;
+};
+
 // Invalid escape sequences
 struct escape_error final : public invalid_error
 {
     using invalid_error::invalid_error;
 };
 
+// Desktop files in autostart directories are interpreted a bit differently
+// (see the Desktop Application Autostart Specification). NoDisplay is ignored,
+// but X-GNOME-Autostart-enabled=false disables them.
+enum class DesktopFileUse { menu, autostart };
+
 class Application
 {
 public:
@@ -59,12 +71,23 @@ public:
     // CWD of program
     std::string path;
 
+    // Icon name or absolute path to an icon
+    std::string icon;
+
     // Path of .desktop file
     std::string location;
 
     // Terminal app
     bool terminal = false;
 
+    // MIME types supported by the app (MimeType key)
+    stringlist_t mime_types;
+
+    // NoDisplay=true (only in DesktopFileUse::menu)
+    // The app isn't shown in the menu, but it can still be launched by its
+    // desktop ID or handle MIME types.
+    bool no_display = false;
+
     // file id
     // It isn't set by Application, it is a helper variable managed by
     // Applications
@@ -72,10 +95,16 @@ public:
 
     bool operator==(const Application &other) const;
 
+    // This constructs an empty Application. It is used only when restoring
+    // the state of AppManager (see StateHandoff.hh).
+    Application() = default;
+
     // If desktopenvs is {}, notShowIn and onlyShowIn will be ignored.
     Application(const char *path, LineReader &liner,
                 const LocaleSuffixes &locale_suffixes,
-                const stringlist_t &desktopenvs);
+                const stringlist_t &desktopenvs,
+                const ParsingLimits &limits = {},
+                DesktopFileUse use = DesktopFileUse::menu);
 
 private:
     static char convert(char escape);
@@ -18,9 +18,15 @@
 #include "Dmenu.hh"
 
 #include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdexcept>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -36,8 +42,18 @@ void Dmenu::write(std::string_view what) {
     writen(this->outpipe[1], "\n", 1);
 }
 
+void Dmenu::write_entries(std::string_view entries) {
+    writen(this->outpipe[1], entries.data(), entries.size());
+}
+
 void Dmenu::display() {
     SPDLOG_DEBUG("Dmenu: Displaying Dmenu.");
+    if (!this->unwritten_menu.empty()) {
+        writen(this->outpipe[1], this->unwritten_menu.data(),
+               this->unwritten_menu.size());
+        this->unwritten_menu.clear();
+    }
+    this->prefilled = false;
     // Closing the pipe produces EOF for dmenu, signalling
     // end of all options. dmenu shows now up on the screen
     // (if -f hasn't been used)
@@ -81,6 +97,18 @@ std::string Dmenu::read_choice() {
 }
 
 void Dmenu::run() {
+    if (this->standby_pid != 0) {
+        SPDLOG_DEBUG("Dmenu: Running standby Dmenu.");
+        // Wake the child up.
+        if (writen(this->standby_control, "", 1) == -1)
+            PFATALE("write");
+        close(this->standby_control);
+        this->standby_control = -1;
+        this->pid = this->standby_pid;
+        this->standby_pid = 0;
+        return;
+    }
+
     // Create the dmenu as soon as we know the command,
     // this speeds up things a bit if the -f flag for dmenu is
     // used
@@ -104,14 +132,135 @@ void Dmenu::run() {
         close(this->inpipe[1]);
         close(this->outpipe[0]);
 
-        execl(
-            shell, shell, "-c", this->dmenu_command.c_str(), 0,
-            nullptr); // double nulls are needed because of
-                      // https://github.com/enkore/j4-dmenu-desktop/pull/66#issuecomment-273126739
-        SPDLOG_ERROR("Couldn't execute dmenu!");
-        _exit(EXIT_FAILURE);
+        exec_dmenu();
+    }
+
+    close(this->inpipe[1]);
+    close(this->outpipe[0]);
+}
+
+void Dmenu::exec_dmenu() {
+    execl(this->shell, this->shell, "-c", this->dmenu_command.c_str(), 0,
+          nullptr); // double nulls are needed because of
+                    // https://github.com/enkore/j4-dmenu-desktop/pull/66#issuecomment-273126739
+    SPDLOG_ERROR("Couldn't execute dmenu!");
+    _exit(EXIT_FAILURE);
+}
+
+#ifdef F_SETPIPE_SZ
+// Return /proc/sys/fs/pipe-max-size or -1 if it can't be read.
+static long get_max_pipe_size() {
+    FILE *f = fopen("/proc/sys/fs/pipe-max-size", "r");
+    if (f == NULL)
+        return -1;
+    long result;
+    if (fscanf(f, "%ld", &result) != 1)
+        result = -1;
+    fclose(f);
+    return result;
+}
+#endif
+
+void Dmenu::prepare_standby(std::string_view menu) {
+    discard_standby();
+
+    SPDLOG_DEBUG("Dmenu: Preparing standby Dmenu.");
+
+    // All descriptors are close-on-exec. Programs executed by j4dd in
+    // wait-on mode mustn't keep the input of dmenu open, dmenu would never
+    // receive EOF.
+    int control[2];
+    if (pipe2(this->inpipe.data(), O_CLOEXEC) == -1 ||
+        pipe2(this->outpipe.data(), O_CLOEXEC) == -1 ||
+        pipe2(control, O_CLOEXEC) == -1)
+        throw std::runtime_error("Dmenu::prepare_standby(): pipe2() failed");
+
+#ifdef F_SETPIPE_SZ
+    int pipe_size = fcntl(this->outpipe[1], F_GETPIPE_SZ);
+    if (pipe_size != -1 && (size_t)pipe_size < menu.size()) {
+        long requested_size = std::min(menu.size(), (size_t)INT_MAX);
+        // Unprivileged processes can't go over this limit.
+        long max_size = get_max_pipe_size();
+        if (max_size > 0)
+            requested_size = std::min(requested_size, max_size);
+        if (fcntl(this->outpipe[1], F_SETPIPE_SZ, (int)requested_size) == -1)
+            SPDLOG_DEBUG("Dmenu: Couldn't enlarge pipe to {} bytes: {}",
+                         requested_size, strerror(errno));
+    }
+#endif
+
+    this->standby_pid = fork();
+    switch (this->standby_pid) {
+    case -1:
+        throw std::runtime_error("Dmenu::prepare_standby(): fork() failed");
+    case 0: {
+        close(control[1]);
+        close(this->inpipe[0]);
+        close(this->outpipe[1]);
+
+        char data;
+        ssize_t ret;
+        while ((ret = read(control[0], &data, 1)) == -1 && errno == EINTR)
+            ;
+        // The standby has been discarded.
+        if (ret != 1)
+            _exit(EXIT_SUCCESS);
+
+        dup2(this->inpipe[1], STDOUT_FILENO);
+        dup2(this->outpipe[0], STDIN_FILENO);
+
+        exec_dmenu();
+    }
     }
 
+    close(control[0]);
     close(this->inpipe[1]);
     close(this->outpipe[0]);
+    this->standby_control = control[1];
+
+    // Write as much of the menu as the pipe can hold without blocking.
+    int flags = fcntl(this->outpipe[1], F_GETFL);
+    if (flags == -1 ||
+        fcntl(this->outpipe[1], F_SETFL, flags | O_NONBLOCK) == -1)
+        PFATALE("fcntl");
+    while (!menu.empty()) {
+        ssize_t written = ::write(this->outpipe[1], menu.data(), menu.size());
+        if (written == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                break;
+            PFATALE("write");
+        }
+        menu.remove_prefix(written);
+    }
+    if (fcntl(this->outpipe[1], F_SETFL, flags) == -1)
+        PFATALE("fcntl");
+
+    if (!menu.empty())
+        SPDLOG_DEBUG("Dmenu: {} bytes of the menu didn't fit into the pipe.",
+                     menu.size());
+    this->unwritten_menu = menu;
+    this->prefilled = true;
+}
+
+void Dmenu::discard_standby() {
+    if (this->standby_pid == 0)
+        return;
+
+    SPDLOG_DEBUG("Dmenu: Discarding standby Dmenu.");
+    // The child will receive EOF and exit.
+    close(this->standby_control);
+    close(this->inpipe[0]);
+    close(this->outpipe[1]);
+    while (waitpid(this->standby_pid, NULL, 0) == -1 && errno == EINTR)
+        ;
+    this->standby_pid = 0;
+    this->standby_control = -1;
+    this->unwritten_menu.clear();
+    this->prefilled = false;
+}
+
+bool Dmenu::is_prefilled() const {
+    return this->prefilled;
 }
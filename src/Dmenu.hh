@@ -37,17 +37,45 @@ public:
     // The caller may wish to handle SIGPIPE to detect dmenu failure when
     // calling write().
     void write(std::string_view what);
+    // Write several entries at once. Each entry must be terminated by a
+    // newline.
+    void write_entries(std::string_view entries);
     void display();
     std::string read_choice();
     void run();
 
+    // Fork a standby child in advance. The child waits until run() is called
+    // and then executes the dmenu command. This saves the time needed to
+    // create pipes and fork when the menu is actually requested.
+    //
+    // menu (a list of entries terminated by newlines) is written to the input
+    // of the child in advance. The pipe is enlarged to fit the whole menu if
+    // possible, the rest is written by display(). write() and write_entries()
+    // mustn't be used after run() when prepare_standby() has been called.
+    //
+    // An existing standby child is discarded.
+    void prepare_standby(std::string_view menu);
+    void discard_standby();
+    // Return true if the menu has been written by prepare_standby() and it
+    // hasn't been displayed yet.
+    bool is_prefilled() const;
+
 private:
+    [[noreturn]] void exec_dmenu();
+
     std::string dmenu_command;
     const char *shell;
 
     std::array<int, 2> inpipe;
     std::array<int, 2> outpipe;
     int pid = 0;
+
+    // These are set by prepare_standby().
+    int standby_pid = 0;
+    int standby_control = -1;
+    // Part of the menu which didn't fit into the pipe.
+    std::string unwritten_menu;
+    bool prefilled = false;
 };
 
 static_assert(std::is_move_constructible_v<Dmenu>);
@@ -24,8 +24,21 @@
 #include "Application.hh"
 #include "Utilities.hh"
 
+std::vector<std::string> split_user_arguments(const std::string &arguments) {
+    auto result = split(arguments, ' ');
+    // Remove empty elements.
+    result.erase(std::remove(result.begin(), result.end(), std::string()),
+                 result.end());
+    return result;
+}
+
 void expand_field_codes(std::vector<std::string> &args, const Application &app,
                         const std::string &user_arguments) {
+    expand_field_codes(args, app, split_user_arguments(user_arguments));
+}
+
+void expand_field_codes(std::vector<std::string> &args, const Application &app,
+                        const std::vector<std::string> &user_arguments) {
     for (auto iter = args.begin(); iter != args.end(); ++iter) {
         std::string &arg = *iter;
         auto field_code_pos = arg.find('%');
@@ -48,13 +61,7 @@ void expand_field_codes(std::vector<std::string> &args, const Application &app,
         case 'F':
         case 'u':
         case 'U': {
-            auto split_user_arguments = split(user_arguments, ' ');
-            // Remove empty elements.
-            split_user_arguments.erase(std::remove(split_user_arguments.begin(),
-                                                   split_user_arguments.end(),
-                                                   std::string()),
-                                       split_user_arguments.end());
-            if (split_user_arguments.empty()) {
+            if (user_arguments.empty()) {
                 // If the argument doesn't contain anything except the field
                 // code...
                 if (field_code_pos == 0 && arg.size() == 2) {
@@ -75,8 +82,8 @@ void expand_field_codes(std::vector<std::string> &args, const Application &app,
                     // subject to change.
                     arg.erase(field_code_pos, 2);
                 }
-            } else if (split_user_arguments.size() == 1) {
-                arg.replace(field_code_pos, 2, user_arguments);
+            } else if (user_arguments.size() == 1) {
+                arg.replace(field_code_pos, 2, user_arguments.front());
             } else {
                 // If the provided Exec argument is "1234%f5678" and user
                 // arguments are {"first", "second", "third"}, the Exec argument
@@ -86,19 +93,19 @@ void expand_field_codes(std::vector<std::string> &args, const Application &app,
                 // field code as a standalone argument (such as "%f"). In that
                 // case, the following code will behave as if the single element
                 // of args vector containing the sole field code will be
-                // replaced by split_user_arguments.
+                // replaced by user_arguments.
                 std::string suffix;
                 if (field_code_pos + 2 < args.size())
                     suffix = arg.substr(field_code_pos + 2);
 
                 arg.erase(field_code_pos);
-                arg += split_user_arguments.front();
+                arg += user_arguments.front();
 
                 iter = args.insert(std::next(iter),
-                                   std::next(split_user_arguments.cbegin()),
-                                   std::prev(split_user_arguments.cend()));
-                iter += split_user_arguments.size() - 2;
-                iter = args.insert(iter, split_user_arguments.back() + suffix);
+                                   std::next(user_arguments.cbegin()),
+                                   std::prev(user_arguments.cend()));
+                iter += user_arguments.size() - 2;
+                iter = args.insert(iter, user_arguments.back() + suffix);
                 ++iter;
 
                 // See comment above.
@@ -113,7 +120,26 @@ void expand_field_codes(std::vector<std::string> &args, const Application &app,
         case 'k':
             arg.replace(field_code_pos, 2, app.location);
             break;
-        case 'i': // icons aren't handled
+        case 'i':
+            // %i expands to two arguments, "--icon" and the value of the Icon
+            // key. It expands to nothing if the Icon key is missing.
+            if (field_code_pos == 0 && arg.size() == 2) {
+                if (iter == args.begin())
+                    throw std::runtime_error(
+                        "Field code %i can't be used in place of executable.");
+                if (app.icon.empty()) {
+                    // Step back so that the following argument isn't skipped.
+                    iter = std::prev(args.erase(iter));
+                } else {
+                    arg = "--icon";
+                    iter = args.insert(std::next(iter), app.icon);
+                }
+            } else {
+                // The spec doesn't allow this, but handle it gracefully
+                // anyway.
+                arg.replace(field_code_pos, 2, app.icon);
+            }
+            break;
         case 'd': // ignore deprecated entries
         case 'D':
         case 'n':
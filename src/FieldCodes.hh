@@ -23,9 +23,19 @@
 
 class Application;
 
+// Split arguments typed by the user after the name of an app in dmenu. They are
+// separated by spaces, quoting isn't supported.
+std::vector<std::string> split_user_arguments(const std::string &arguments);
+
 // This function should be used on the output of convert_exec_to_command().
 // It expands field codes in every argument.
 void expand_field_codes(std::vector<std::string> &args, const Application &app,
                         const std::string &user_arguments);
 
+// This is the same as above, but user arguments have already been split. This
+// is used for launch requests (see LaunchRequest.hh), which can pass arguments
+// containing spaces.
+void expand_field_codes(std::vector<std::string> &args, const Application &app,
+                        const std::vector<std::string> &user_arguments);
+
 #endif
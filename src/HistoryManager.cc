@@ -200,6 +200,9 @@ HistoryManager HistoryManager::convert_history_from_v0(const string &path,
         try {
             auto lookup = appm.lookup_by_ID(line);
             const Application &app = lookup.value();
+            // These apps aren't in the menu, they can't be in history.
+            if (app.no_display)
+                continue;
             if (ensure_uniqueness.emplace(app.name).second)
                 result.emplace(std::piecewise_construct,
                                std::forward_as_tuple(hist_count),
@@ -0,0 +1,528 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "IconLookup.hh"
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <errno.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LineReader.hh"
+
+#define ICON_CACHE_HEADER "j4dd icon cache v1"
+
+IconLookup::Directory::Directory(std::string name) : name(std::move(name)) {}
+
+int IconLookup::Directory::distance(int requested_size) const {
+    switch (this->type) {
+    case Type::fixed:
+        return abs(this->size - requested_size);
+    case Type::scalable:
+        if (requested_size < this->min_size)
+            return this->min_size - requested_size;
+        if (requested_size > this->max_size)
+            return requested_size - this->max_size;
+        return 0;
+    case Type::threshold:
+    default:
+        if (requested_size < this->size - this->threshold)
+            return this->min_size - requested_size;
+        if (requested_size > this->size + this->threshold)
+            return requested_size - this->max_size;
+        return 0;
+    }
+}
+
+IconLookup::IconLookup(std::string theme, int size, stringlist_t base_dirs,
+                       const std::string &cache_path)
+    : theme(std::move(theme)), size(size), base_dirs(std::move(base_dirs)),
+      cache_path(cache_path) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (!cache_path.empty() && load_cache(cache_path))
+        this->from_cache = true;
+    else
+        build_and_save();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    SPDLOG_INFO("IconLookup: {} {} icons of theme '{}' in {} us.",
+                (this->from_cache ? "Loaded" : "Indexed"), this->index.size(),
+                this->theme, elapsed.count());
+}
+
+std::string_view IconLookup::lookup(const std::string &icon) const {
+    if (icon.empty())
+        return {};
+    if (icon.front() == '/')
+        return icon;
+
+    auto result = this->index.find(icon);
+    if (result != this->index.end())
+        return result->second;
+
+    // Some desktop files include the extension in the Icon key. The spec
+    // doesn't allow this, but it is common enough to be handled.
+    if (endswith(icon, ".png") || endswith(icon, ".svg") ||
+        endswith(icon, ".xpm")) {
+        result = this->index.find(icon.substr(0, icon.size() - 4));
+        if (result != this->index.end())
+            return result->second;
+    }
+
+    return {};
+}
+
+bool IconLookup::is_outdated() const {
+    return ::is_outdated(this->watched_paths);
+}
+
+void IconLookup::rebuild() {
+    auto start = std::chrono::steady_clock::now();
+
+    this->from_cache = false;
+    build_and_save();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    SPDLOG_INFO("IconLookup: Reindexed {} icons of theme '{}' in {} us.",
+                this->index.size(), this->theme, elapsed.count());
+}
+
+void IconLookup::build_and_save() {
+    this->index.clear();
+    this->watched_paths.clear();
+    build_index();
+    if (!this->cache_path.empty())
+        save_cache(this->cache_path);
+}
+
+bool IconLookup::is_loaded_from_cache() const {
+    return this->from_cache;
+}
+
+size_t IconLookup::count() const {
+    return this->index.size();
+}
+
+stringlist_t IconLookup::get_base_dirs() {
+    stringlist_t result;
+
+    std::string home = get_variable("HOME");
+    if (!home.empty())
+        result.push_back(home + "/.icons/");
+
+    std::string xdg_data_home = get_variable("XDG_DATA_HOME");
+    if (xdg_data_home.empty() && !home.empty())
+        xdg_data_home = home + "/.local/share";
+    if (!xdg_data_home.empty())
+        result.push_back(xdg_data_home + "/icons/");
+
+    std::string xdg_data_dirs = get_variable("XDG_DATA_DIRS");
+    if (xdg_data_dirs.empty())
+        xdg_data_dirs = "/usr/local/share/:/usr/share/";
+    for (std::string &path : split(xdg_data_dirs, ':')) {
+        if (path.empty())
+            continue;
+        if (path.back() != '/')
+            path += '/';
+        result.push_back(path + "icons/");
+    }
+
+    result.push_back("/usr/share/pixmaps/");
+
+    return result;
+}
+
+bool IconLookup::watch(const std::string &path) {
+    return this->watched_paths.emplace_back(path).exists();
+}
+
+// Remove leading and trailing spaces.
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && str.front() == ' ')
+        str.remove_prefix(1);
+    while (!str.empty() && str.back() == ' ')
+        str.remove_suffix(1);
+    return str;
+}
+
+static stringlist_t split_list(std::string_view value) {
+    stringlist_t result;
+    for (const std::string &item : split((std::string)value, ',')) {
+        std::string_view trimmed = trim(item);
+        if (!trimmed.empty())
+            result.emplace_back(trimmed);
+    }
+    return result;
+}
+
+bool IconLookup::read_theme(const std::string &name, Theme &result) {
+    bool found = false;
+    std::string index_path;
+
+    // All base dirs have to be watched, a theme may be added to a base dir
+    // with higher priority.
+    for (const std::string &base : this->base_dirs) {
+        if (!watch(base + name + '/'))
+            continue;
+        std::string path = base + name + "/index.theme";
+        if (!watch(path))
+            continue;
+        if (!found) {
+            found = true;
+            index_path = std::move(path);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    std::unique_ptr<FILE, fclose_deleter> file(
+        fopen(index_path.c_str(), "r"));
+    if (!file) {
+        SPDLOG_WARN("Couldn't open '{}': {}", index_path, strerror(errno));
+        return false;
+    }
+
+    stringlist_t directory_names;
+    std::unordered_map<std::string, Directory> sections;
+    Directory *current = nullptr;
+    bool in_theme_section = false;
+
+    LineReader liner;
+    ssize_t line_length;
+    while ((line_length = liner.getline(file.get())) != -1) {
+        std::string_view line(liner.get_lineptr(), line_length);
+        if (!line.empty() && line.back() == '\n')
+            line.remove_suffix(1);
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        if (line.front() == '[') {
+            if (line.back() != ']') {
+                current = nullptr;
+                in_theme_section = false;
+                continue;
+            }
+            std::string section(line.substr(1, line.size() - 2));
+            in_theme_section = section == "Icon Theme";
+            if (in_theme_section)
+                current = nullptr;
+            else
+                current = &sections.try_emplace(section, section).first->second;
+            continue;
+        }
+
+        auto equal_sign = line.find('=');
+        if (equal_sign == std::string_view::npos)
+            continue;
+        std::string_view key = trim(line.substr(0, equal_sign));
+        std::string_view value = trim(line.substr(equal_sign + 1));
+
+        if (in_theme_section) {
+            if (key == "Inherits")
+                result.inherits = split_list(value);
+            else if (key == "Directories")
+                directory_names = split_list(value);
+        } else if (current != nullptr) {
+            if (key == "Type") {
+                if (value == "Fixed")
+                    current->type = Directory::Type::fixed;
+                else if (value == "Scalable")
+                    current->type = Directory::Type::scalable;
+                else
+                    current->type = Directory::Type::threshold;
+                continue;
+            }
+
+            int number = atoi(std::string(value).c_str());
+            if (key == "Size")
+                current->size = number;
+            else if (key == "Scale")
+                current->scale = number;
+            else if (key == "MinSize")
+                current->min_size = number;
+            else if (key == "MaxSize")
+                current->max_size = number;
+            else if (key == "Threshold")
+                current->threshold = number;
+        }
+    }
+
+    for (const std::string &dir_name : directory_names) {
+        auto section = sections.find(dir_name);
+        if (section == sections.end() || section->second.size <= 0) {
+            SPDLOG_DEBUG("IconLookup: Directory '{}' of theme '{}' doesn't "
+                         "have a valid Size, skipping.",
+                         dir_name, name);
+            continue;
+        }
+        Directory &dir = section->second;
+        if (dir.min_size == -1)
+            dir.min_size = dir.size;
+        if (dir.max_size == -1)
+            dir.max_size = dir.size;
+        result.directories.push_back(std::move(dir));
+    }
+
+    return true;
+}
+
+std::vector<std::pair<std::string, IconLookup::Theme>>
+IconLookup::get_theme_chain() {
+    std::vector<std::pair<std::string, Theme>> result;
+    // This includes themes which couldn't be found.
+    stringlist_t visited;
+
+    // Themes are searched depth first as mandated by the spec.
+    std::vector<std::string> stack{"hicolor", this->theme};
+    while (!stack.empty()) {
+        std::string name = std::move(stack.back());
+        stack.pop_back();
+
+        if (std::find(visited.begin(), visited.end(), name) != visited.end())
+            continue;
+        visited.push_back(name);
+
+        Theme current;
+        if (!read_theme(name, current)) {
+            if (name == this->theme)
+                SPDLOG_WARN("Couldn't find icon theme '{}'.", name);
+            else
+                SPDLOG_INFO("IconLookup: Couldn't find icon theme '{}'.",
+                            name);
+            continue;
+        }
+        for (auto iter = current.inherits.rbegin();
+             iter != current.inherits.rend(); ++iter)
+            stack.push_back(*iter);
+        result.emplace_back(std::move(name), std::move(current));
+    }
+
+    return result;
+}
+
+// Returns the rank of supported icon extensions (lower is better) or -1 if the
+// extension isn't supported. The order is given by the spec.
+static int get_extension_rank(std::string_view filename) {
+    if (endswith((std::string)filename, ".png"))
+        return 0;
+    if (endswith((std::string)filename, ".svg"))
+        return 1;
+    if (endswith((std::string)filename, ".xpm"))
+        return 2;
+    return -1;
+}
+
+// Call func(icon name, extension rank, filename) for all icons in directory
+// path.
+template <typename F>
+static void for_each_icon(const std::string &path, F &&func) {
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL)
+        return;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        std::string_view filename = entry->d_name;
+        if (filename.front() == '.')
+            continue;
+        // These characters are used as separators in the cache.
+        if (filename.find_first_of("\t\n") != std::string_view::npos)
+            continue;
+        int ext_rank = get_extension_rank(filename);
+        if (ext_rank == -1)
+            continue;
+        func(filename.substr(0, filename.size() - 4), ext_rank, filename);
+    }
+    closedir(dir);
+}
+
+void IconLookup::build_index() {
+    for (const std::string &base : this->base_dirs)
+        watch(base);
+
+    for (const auto &[name, theme] : get_theme_chain()) {
+        struct Candidate
+        {
+            int distance;
+            int ext_rank;
+            std::string path;
+
+            Candidate(int d, int e, std::string p)
+                : distance(d), ext_rank(e), path(std::move(p)) {}
+        };
+
+        // Icons found in this theme. An icon present in a theme takes
+        // precedence over icons in inherited themes even when their size
+        // matches better.
+        std::unordered_map<std::string, Candidate> theme_icons;
+
+        // There is no need to watch subdirectories of a nonexistent theme
+        // directory; the creation of the theme directory would change the
+        // mtime of the base dir.
+        stringlist_t theme_dirs;
+        for (const std::string &base : this->base_dirs) {
+            if (is_directory(base + name))
+                theme_dirs.push_back(base + name + '/');
+        }
+
+        for (const Directory &dir : theme.directories) {
+            if (dir.scale != 1)
+                continue;
+            int distance = dir.distance(this->size);
+            for (const std::string &theme_dir : theme_dirs) {
+                std::string path = theme_dir + dir.name + '/';
+                if (!watch(path))
+                    continue;
+                for_each_icon(path, [&](std::string_view icon, int ext_rank,
+                                        std::string_view filename) {
+                    auto [iter, inserted] = theme_icons.try_emplace(
+                        (std::string)icon, distance, ext_rank,
+                        path + (std::string)filename);
+                    if (inserted)
+                        return;
+                    Candidate &old = iter->second;
+                    if (distance < old.distance ||
+                        (distance == old.distance && ext_rank < old.ext_rank))
+                        old = Candidate(distance, ext_rank,
+                                        path + (std::string)filename);
+                });
+            }
+        }
+
+        SPDLOG_DEBUG("IconLookup: Found {} icons in theme '{}'.",
+                     theme_icons.size(), name);
+
+        for (auto &[icon, candidate] : theme_icons)
+            this->index.try_emplace(icon, std::move(candidate.path));
+    }
+
+    // Fallback icons are located directly in base directories.
+    for (const std::string &base : this->base_dirs) {
+        std::unordered_map<std::string, int> ext_ranks;
+        for_each_icon(base, [&](std::string_view icon, int ext_rank,
+                                std::string_view filename) {
+            auto [iter, inserted] = this->index.try_emplace(
+                (std::string)icon, base + (std::string)filename);
+            if (inserted)
+                ext_ranks.emplace(icon, ext_rank);
+            else {
+                auto rank = ext_ranks.find((std::string)icon);
+                if (rank != ext_ranks.end() && ext_rank < rank->second) {
+                    rank->second = ext_rank;
+                    iter->second = base + (std::string)filename;
+                }
+            }
+        });
+    }
+}
+
+std::string IconLookup::get_cache_key() const {
+    return this->theme + '\t' + std::to_string(this->size) + '\t' +
+           join(this->base_dirs, ':');
+}
+
+bool IconLookup::load_cache(const std::string &cache_path) {
+    std::unique_ptr<FILE, fclose_deleter> file(
+        fopen(cache_path.c_str(), "r"));
+    if (!file) {
+        if (errno != ENOENT)
+            SPDLOG_WARN("Couldn't open icon cache '{}': {}", cache_path,
+                        strerror(errno));
+        return false;
+    }
+
+    LineReader liner;
+    ssize_t line_length;
+
+    auto getline = [&]() -> std::string_view {
+        line_length = liner.getline(file.get());
+        if (line_length <= 0 || liner.get_lineptr()[line_length - 1] != '\n')
+            return {};
+        return std::string_view(liner.get_lineptr(), line_length - 1);
+    };
+
+    if (getline() != ICON_CACHE_HEADER) {
+        SPDLOG_INFO("IconLookup: Icon cache '{}' has unknown format, "
+                    "rebuilding.",
+                    cache_path);
+        return false;
+    }
+    if (getline() != get_cache_key()) {
+        SPDLOG_INFO("IconLookup: Icon cache '{}' was created with different "
+                    "settings, rebuilding.",
+                    cache_path);
+        return false;
+    }
+
+    unsigned long watched_count = strtoul(std::string(getline()).c_str(),
+                                          nullptr, 10);
+    for (unsigned long i = 0; i < watched_count; ++i) {
+        std::string_view line = getline();
+        long long sec, nsec;
+        int path_offset;
+        if (sscanf(std::string(line).c_str(), "%lld %lld %n", &sec, &nsec,
+                   &path_offset) != 2) {
+            SPDLOG_WARN("Icon cache '{}' is malformed!", cache_path);
+            return false;
+        }
+        // The paths are kept for is_outdated().
+        const WatchedPath &current = this->watched_paths.emplace_back(
+            (std::string)line.substr(path_offset));
+        if (current.mtime.tv_sec != sec || current.mtime.tv_nsec != nsec) {
+            SPDLOG_INFO("IconLookup: '{}' has changed, rebuilding icon cache.",
+                        current.path);
+            return false;
+        }
+    }
+
+    while ((line_length = liner.getline(file.get())) != -1) {
+        std::string_view line(liner.get_lineptr(), line_length);
+        if (!line.empty() && line.back() == '\n')
+            line.remove_suffix(1);
+        auto tab = line.find('\t');
+        if (tab == std::string_view::npos) {
+            SPDLOG_WARN("Icon cache '{}' is malformed!", cache_path);
+            return false;
+        }
+        this->index.try_emplace((std::string)line.substr(0, tab),
+                                line.substr(tab + 1));
+    }
+
+    return true;
+}
+
+void IconLookup::save_cache(const std::string &cache_path) const {
+    write_cache_file(cache_path, "icon cache", [this](FILE *file) {
+        fmt::print(file, ICON_CACHE_HEADER "\n{}\n{}\n", get_cache_key(),
+                   this->watched_paths.size());
+        for (const WatchedPath &watched : this->watched_paths)
+            fmt::print(file, "{} {} {}\n", (long long)watched.mtime.tv_sec,
+                       (long long)watched.mtime.tv_nsec, watched.path);
+        for (const auto &[icon, path] : this->index)
+            fmt::print(file, "{}\t{}\n", icon, path);
+    });
+}
@@ -0,0 +1,132 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef ICONLOOKUP_DEF
+#define ICONLOOKUP_DEF
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Utilities.hh"
+
+/*
+ * This class resolves icon names used in the Icon key of desktop files to
+ * paths according to the Icon Theme Specification.
+ *
+ * Resolving an icon the way the specification describes it means walking the
+ * theme inheritance chain and checking for the icon in many directories. This
+ * is too slow to do for each desktop file. IconLookup instead walks all
+ * relevant directories once and builds an index of all icon names. Icons are
+ * then resolved with a single hash table lookup.
+ *
+ * The index is saved to a cache file. The cache stores mtimes of all
+ * directories (and index.theme files) that were read while building the
+ * index. The cache is used only when none of them have changed. The same paths
+ * are used by is_outdated() to detect changes of the themes in long running
+ * processes (--wait-on).
+ *
+ * For a theme of Adwaita's size inheriting from hicolor (about 14000 files in
+ * 260 directories), building the index takes about 8 ms and loading the cache
+ * takes less than 1 ms.
+ *
+ * Scaled directories (Scale > 1) are ignored.
+ */
+class IconLookup
+{
+public:
+    // base_dirs must end with '/'. cache_path may be empty, the index won't be
+    // cached then.
+    IconLookup(std::string theme, int size, stringlist_t base_dirs,
+               const std::string &cache_path);
+
+    // Returns the path to the icon or an empty string_view if the icon
+    // couldn't be found. Absolute paths are returned as is.
+    std::string_view lookup(const std::string &icon) const;
+
+    // Return true if any of the theme directories has changed since the index
+    // has been built (or since the cache has been created).
+    bool is_outdated() const;
+    // Build the index again and update the cache.
+    void rebuild();
+
+    // This is primarily for logging and testing.
+    bool is_loaded_from_cache() const;
+    size_t count() const;
+
+    // Return $HOME/.icons, $XDG_DATA_HOME/icons, $XDG_DATA_DIRS/icons and
+    // /usr/share/pixmaps in this order.
+    static stringlist_t get_base_dirs();
+
+private:
+    struct Directory
+    {
+        enum class Type { fixed, scalable, threshold };
+
+        std::string name;
+        int size = 0;
+        int scale = 1;
+        Type type = Type::threshold;
+        // MinSize and MaxSize default to Size. -1 means unset.
+        int min_size = -1;
+        int max_size = -1;
+        int threshold = 2;
+
+        Directory(std::string name);
+
+        int distance(int requested_size) const;
+    };
+
+    struct Theme
+    {
+        stringlist_t inherits;
+        std::vector<Directory> directories;
+    };
+
+    // Build the index from scratch and save it to cache_path if it is set.
+    void build_and_save();
+    void build_index();
+    bool load_cache(const std::string &cache_path);
+    void save_cache(const std::string &cache_path) const;
+
+    // Stat path and add it to watched_paths. Returns true if path exists.
+    bool watch(const std::string &path);
+    // Reads index.theme of theme from the first base dir which has it.
+    bool read_theme(const std::string &name, Theme &result);
+    // Return the requested theme, all themes it inherits from and hicolor in
+    // the order in which they should be searched.
+    std::vector<std::pair<std::string, Theme>> get_theme_chain();
+    // Key identifying configuration of IconLookup in the cache.
+    std::string get_cache_key() const;
+
+    std::string theme;
+    int size;
+    stringlist_t base_dirs;
+    std::string cache_path;
+
+    std::unordered_map<std::string /* icon name */, std::string /* path */>
+        index;
+    std::vector<WatchedPath> watched_paths;
+    bool from_cache = false;
+};
+
+static_assert(std::is_move_constructible_v<IconLookup>);
+
+#endif
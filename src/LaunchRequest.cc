@@ -0,0 +1,107 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "LaunchRequest.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <limits.h>
+#include <stdexcept>
+#include <utility>
+
+// The headers contain a null byte, sizeof would count the terminating one too.
+static constexpr std::string_view launch_header("launch\0", 7);
+static constexpr std::string_view open_header("open\0", 5);
+
+std::string LaunchRequest::encode(const Request &request) {
+    std::string result;
+    if (request.type == Type::launch) {
+        if (request.desktop_id.empty())
+            throw std::invalid_argument("Desktop ID can't be empty.");
+        result = launch_header;
+        result += request.desktop_id;
+        result += '\0';
+    } else {
+        if (request.args.empty())
+            throw std::invalid_argument("Nothing to open.");
+        result = open_header;
+    }
+    for (const std::string &arg : request.args) {
+        if (arg.empty())
+            throw std::invalid_argument("Arguments can't be empty.");
+        result += arg;
+        result += '\0';
+    }
+    result += '\0';
+
+    if (result.size() > PIPE_BUF)
+        throw std::invalid_argument("Request is too long.");
+    return result;
+}
+
+LaunchRequest::FifoInput LaunchRequest::parse(std::string_view data) {
+    FifoInput result;
+
+    while (!data.empty()) {
+        Type type;
+        if (data.compare(0, launch_header.size(), launch_header) == 0) {
+            type = Type::launch;
+            data.remove_prefix(launch_header.size());
+        } else if (data.compare(0, open_header.size(), open_header) == 0) {
+            type = Type::open;
+            data.remove_prefix(open_header.size());
+        } else {
+            result.command = data.front();
+            data.remove_prefix(1);
+            continue;
+        }
+
+        stringlist_t fields;
+        bool terminated = false;
+        while (!data.empty()) {
+            auto end = data.find('\0');
+            if (end == std::string_view::npos)
+                break;
+            std::string_view field = data.substr(0, end);
+            data.remove_prefix(end + 1);
+            if (field.empty()) {
+                terminated = true;
+                break;
+            }
+            fields.emplace_back(field);
+        }
+
+        if (!terminated) {
+            SPDLOG_WARN("Received a truncated request, ignoring.");
+            break;
+        }
+        if (fields.empty()) {
+            SPDLOG_WARN("Received an empty {} request, ignoring.",
+                        (type == Type::launch ? "launch" : "open"));
+            continue;
+        }
+        if (type == Type::open) {
+            result.requests.emplace_back(std::move(fields));
+            continue;
+        }
+        std::string desktop_id = std::move(fields.front());
+        fields.erase(fields.begin());
+        result.requests.emplace_back(std::move(desktop_id), std::move(fields));
+    }
+
+    return result;
+}
@@ -0,0 +1,90 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef LAUNCHREQUEST_DEF
+#define LAUNCHREQUEST_DEF
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Utilities.hh"
+
+/*
+ * Messages sent through the --wait-on FIFO.
+ *
+ * Historically, any byte written to the FIFO is a command: 'q' quits the
+ * daemon, 'r' re-executes it and anything else shows dmenu. Only the last byte
+ * is taken into account.
+ *
+ * --launch sends a launch request, which runs a desktop app directly without
+ * showing dmenu:
+ *
+ * launch\0<desktop ID>\0<argument>\0...\0\0
+ *
+ * --open sends an open request, which opens each file or URL with its
+ * preferred app (see MimeApps.hh):
+ *
+ * open\0<file or URL>\0...\0\0
+ *
+ * Requests are terminated by an empty field. Desktop IDs and arguments
+ * therefore can't be empty. Requests are written with a single write() which is
+ * atomic when the request fits into PIPE_BUF, so they can't be interleaved with
+ * other writes.
+ */
+namespace LaunchRequest
+{
+enum class Type { launch, open };
+
+struct Request
+{
+    Type type;
+    // This is empty in open requests.
+    std::string desktop_id;
+    // Arguments for the %f, %F, %u and %U field codes of launch requests or
+    // files and URLs of open requests.
+    stringlist_t args;
+
+    // Construct a launch request.
+    Request(std::string desktop_id, stringlist_t args)
+        : type(Type::launch), desktop_id(std::move(desktop_id)),
+          args(std::move(args)) {}
+
+    // Construct an open request.
+    explicit Request(stringlist_t targets)
+        : type(Type::open), args(std::move(targets)) {}
+};
+
+struct FifoInput
+{
+    std::vector<Request> requests;
+    // The last command byte (see above) if any has been received.
+    std::optional<char> command;
+};
+
+// This throws std::invalid_argument if the desktop ID or an argument is empty,
+// if an open request has no targets or if the request doesn't fit into
+// PIPE_BUF.
+std::string encode(const Request &request);
+
+// Split data read from the FIFO into requests and command bytes.
+// Malformed (truncated) requests are logged and ignored.
+FifoInput parse(std::string_view data);
+}; // namespace LaunchRequest
+
+#endif
@@ -17,13 +17,22 @@
 
 #include "LineReader.hh"
 
+#include <algorithm>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "Utilities.hh"
 
 LineReader::LineReader() {}
 
 LineReader::LineReader(LineReader &&other)
-    : lineptr(other.lineptr), linesz(other.linesz) {
+    : lineptr(other.lineptr), linesz(other.linesz),
+      file_size(other.file_size), position(other.position),
+      line_start(other.line_start) {
     other.lineptr = NULL;
 }
 
@@ -32,6 +41,9 @@ LineReader &LineReader::operator=(LineReader &&other) {
         return *this;
     this->lineptr = other.lineptr;
     this->linesz = other.linesz;
+    this->file_size = other.file_size;
+    this->position = other.position;
+    this->line_start = other.line_start;
 
     other.lineptr = NULL;
     return *this;
@@ -43,9 +55,62 @@ LineReader::~LineReader() {
 }
 
 ssize_t LineReader::getline(FILE *f) {
+    this->line_start = 0;
     return ::getline(&this->lineptr, &this->linesz, f);
 }
 
+ssize_t LineReader::read_file(int fd, size_t max_size) {
+    this->file_size = this->position = this->line_start = 0;
+
+    size_t limit = max_size == 0 ? SIZE_MAX - 1 : max_size + 1;
+    // Try to read the whole file at once. The file could change in the
+    // meantime, so this is only a hint.
+    size_t expected = 4096;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        expected = std::min((size_t)st.st_size + 1, limit);
+
+    while (this->file_size < limit) {
+        // One byte is reserved for the terminating null byte.
+        if (this->lineptr == NULL || this->file_size + 1 >= this->linesz) {
+            size_t new_size =
+                this->lineptr == NULL
+                    ? expected + 1
+                    : std::max(this->linesz * 2, expected + 1);
+            new_size = std::min(new_size, limit + 1);
+            char *new_lineptr = (char *)realloc(this->lineptr, new_size);
+            if (new_lineptr == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            this->lineptr = new_lineptr;
+            this->linesz = new_size;
+        }
+        size_t to_read =
+            std::min(this->linesz - 1, limit) - this->file_size;
+        ssize_t result = readn(fd, this->lineptr + this->file_size, to_read);
+        if (result == -1)
+            return -1;
+        this->file_size += result;
+        if ((size_t)result < to_read)
+            break;
+    }
+    this->lineptr[this->file_size] = '\0';
+    return this->file_size;
+}
+
+ssize_t LineReader::next_line() {
+    if (this->position >= this->file_size)
+        return -1;
+    char *start = this->lineptr + this->position;
+    size_t remaining = this->file_size - this->position;
+    char *newline = (char *)memchr(start, '\n', remaining);
+    size_t length = newline ? newline - start + 1 : remaining;
+    this->line_start = this->position;
+    this->position += length;
+    return length;
+}
+
 char *LineReader::get_lineptr() {
-    return this->lineptr;
+    return this->lineptr + this->line_start;
 }
@@ -22,6 +22,7 @@
 #ifndef LINEREADER_DEF
 #define LINEREADER_DEF
 
+#include <stddef.h>
 #include <stdio.h>
 #include <sys/types.h>
 
@@ -43,11 +44,31 @@ public:
     // procedures (errno).
     ssize_t getline(FILE *f);
 
+    // Read the whole file into memory, its lines can then be read by
+    // next_line(). This is faster than getline() and it reads at most
+    // max_size + 1 bytes (the extra byte is there to detect files which are
+    // too large). max_size == 0 means no limit. The number of bytes read is
+    // returned. On error, -1 is returned and errno is set.
+    ssize_t read_file(int fd, size_t max_size);
+
+    // Return the length of the next line of the file read by read_file()
+    // (including the newline) or -1 if there are no more lines. The line can
+    // be accessed with get_lineptr(). Unlike with getline(), it isn't
+    // terminated by a null byte (unless it's the last line without a trailing
+    // newline), but the newline can be overwritten.
+    ssize_t next_line();
+
     char *get_lineptr();
 
 private:
     char *lineptr = NULL;
     size_t linesz;
+
+    // These are used only by read_file() and next_line().
+    size_t file_size = 0;
+    size_t position = 0;
+    // Offset of the current line in lineptr.
+    size_t line_start = 0;
 };
 
 #endif
@@ -0,0 +1,192 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "MenuCache.hh"
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include "Utilities.hh"
+
+/*
+ * The cache has the following format:
+ *
+ * j4dd menu cache v1
+ * <key length>
+ * <key>
+ * <number of watched paths>
+ * <mtime sec> <mtime nsec> <size> <path>
+ * ...
+ * <menu length>
+ * <menu>
+ *
+ * The key and the menu are stored with their length because they may contain
+ * arbitrary characters.
+ */
+#define MENU_CACHE_HEADER "j4dd menu cache v1"
+
+MenuCache::MenuCache(std::string cache_path, std::string key)
+    : cache_path(std::move(cache_path)), key(std::move(key)) {}
+
+void MenuCache::watch(const std::string &path) {
+    this->watched_paths.emplace_back(path);
+}
+
+// Read the whole file. Returns false on failure.
+static bool read_file(const std::string &path, std::string &result) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno != ENOENT)
+            SPDLOG_WARN("Couldn't open menu cache '{}': {}", path,
+                        strerror(errno));
+        return false;
+    }
+    OnExit close_fd = [fd]() { close(fd); };
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        SPDLOG_WARN("Couldn't stat menu cache '{}': {}", path,
+                    strerror(errno));
+        return false;
+    }
+    result.resize(st.st_size);
+    if (readn(fd, result.data(), result.size()) != (ssize_t)result.size()) {
+        SPDLOG_WARN("Couldn't read menu cache '{}': {}", path,
+                    strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::string> MenuCache::load() const {
+    std::string data;
+    if (!read_file(this->cache_path, data))
+        return {};
+
+    std::string_view rest = data;
+    bool malformed = false;
+
+    auto getline = [&]() -> std::string_view {
+        auto newline = rest.find('\n');
+        if (newline == std::string_view::npos) {
+            malformed = true;
+            return {};
+        }
+        std::string_view line = rest.substr(0, newline);
+        rest.remove_prefix(newline + 1);
+        return line;
+    };
+    auto getnumber = [&]() -> unsigned long {
+        std::string line(getline());
+        char *endptr;
+        errno = 0;
+        unsigned long result = strtoul(line.c_str(), &endptr, 10);
+        if (line.empty() || *endptr != '\0' || errno != 0)
+            malformed = true;
+        return result;
+    };
+    // Read length bytes of data which are followed by a newline.
+    auto getblob = [&](unsigned long length) -> std::string_view {
+        if (malformed || length >= rest.size() || rest[length] != '\n') {
+            malformed = true;
+            return {};
+        }
+        std::string_view blob = rest.substr(0, length);
+        rest.remove_prefix(length + 1);
+        return blob;
+    };
+
+    if (getline() != MENU_CACHE_HEADER) {
+        SPDLOG_INFO("MenuCache: Menu cache '{}' has unknown format, ignoring.",
+                    this->cache_path);
+        return {};
+    }
+    std::string_view cached_key = getblob(getnumber());
+    if (malformed) {
+        SPDLOG_WARN("Menu cache '{}' is malformed!", this->cache_path);
+        return {};
+    }
+    if (cached_key != this->key) {
+        SPDLOG_INFO("MenuCache: Menu cache '{}' was created with different "
+                    "settings, ignoring.",
+                    this->cache_path);
+        return {};
+    }
+
+    unsigned long watched_count = getnumber();
+    for (unsigned long i = 0; i < watched_count && !malformed; ++i) {
+        std::string line(getline());
+        long long sec, nsec, size;
+        int path_offset;
+        if (sscanf(line.c_str(), "%lld %lld %lld %n", &sec, &nsec, &size,
+                   &path_offset) != 3) {
+            malformed = true;
+            break;
+        }
+        WatchedPath current(line.substr(path_offset));
+        if (current.mtime.tv_sec != sec || current.mtime.tv_nsec != nsec ||
+            current.size != size) {
+            SPDLOG_INFO("MenuCache: '{}' has changed, ignoring menu cache.",
+                        current.path);
+            return {};
+        }
+    }
+
+    std::string_view menu = getblob(getnumber());
+    if (malformed || !rest.empty()) {
+        SPDLOG_WARN("Menu cache '{}' is malformed!", this->cache_path);
+        return {};
+    }
+    return std::string(menu);
+}
+
+void MenuCache::save(const std::string &menu) const {
+    for (const WatchedPath &watched : this->watched_paths) {
+        // This would break the format.
+        if (watched.path.find('\n') != std::string::npos) {
+            SPDLOG_INFO("MenuCache: Watched path '{}' contains a newline, "
+                        "menu won't be cached.",
+                        watched.path);
+            return;
+        }
+    }
+
+    bool saved = write_cache_file(
+        this->cache_path, "menu cache", [this, &menu](FILE *file) {
+            fmt::print(file, MENU_CACHE_HEADER "\n{}\n{}\n{}\n",
+                       this->key.size(), this->key,
+                       this->watched_paths.size());
+            for (const WatchedPath &watched : this->watched_paths)
+                fmt::print(file, "{} {} {} {}\n",
+                           (long long)watched.mtime.tv_sec,
+                           (long long)watched.mtime.tv_nsec,
+                           (long long)watched.size, watched.path);
+            fmt::print(file, "{}\n{}\n", menu.size(), menu);
+        });
+    if (saved)
+        SPDLOG_DEBUG("Saved menu cache '{}'.", this->cache_path);
+}
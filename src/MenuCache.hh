@@ -0,0 +1,65 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef MENUCACHE_DEF
+#define MENUCACHE_DEF
+
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Utilities.hh"
+
+/*
+ * MenuCache stores the menu exactly as it was last written to dmenu. The menu
+ * can then be shown right away on the next run of j4-dmenu-desktop before any
+ * desktop files are read.
+ *
+ * Validating the menu properly would require reading all desktop files, which
+ * is the thing the cache is trying to avoid. The cache instead stores a cheap
+ * fingerprint: a key describing the configuration of j4-dmenu-desktop and
+ * mtimes and sizes of watched paths (directories containing desktop files and
+ * the history file). This catches added and removed desktop files, but it
+ * doesn't catch desktop files modified in place. The cached menu is therefore
+ * only speculative, the caller must read desktop files anyway, check the
+ * selection against them and save the up-to-date menu.
+ */
+class MenuCache
+{
+public:
+    MenuCache(std::string cache_path, std::string key);
+
+    // Stat path and remember its mtime and size. This should be done before
+    // path is read.
+    void watch(const std::string &path);
+
+    // Return the cached menu if it was created with the same key and none of
+    // the paths watched when it was saved have changed since.
+    std::optional<std::string> load() const;
+    // Save menu with all paths registered by watch().
+    void save(const std::string &menu) const;
+
+private:
+    std::string cache_path;
+    std::string key;
+    std::vector<WatchedPath> watched_paths;
+};
+
+static_assert(std::is_move_constructible_v<MenuCache>);
+
+#endif
@@ -0,0 +1,190 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "MimeApps.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <errno.h>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include "LineReader.hh"
+
+// Remove leading and trailing whitespace.
+static std::string_view trim_blanks(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+        str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+        str.remove_suffix(1);
+    return str;
+}
+
+MimeApps::MimeApps(stringlist_t files) {
+    for (const std::string &file : files)
+        read_file(file);
+}
+
+void MimeApps::read_file(const std::string &path) {
+    this->watched_paths.emplace_back(path);
+    std::unique_ptr<FILE, fclose_deleter> file(fopen(path.c_str(), "r"));
+    if (!file) {
+        if (errno != ENOENT)
+            SPDLOG_WARN("Couldn't open '{}': {}", path, strerror(errno));
+        return;
+    }
+    SPDLOG_DEBUG("MimeApps: Reading '{}'.", path);
+
+    MimeAppsList &list = this->lists.emplace_back();
+    association_map *group = nullptr;
+
+    LineReader liner;
+    ssize_t line_length;
+    while ((line_length = liner.getline(file.get())) != -1) {
+        std::string_view line(liner.get_lineptr(), line_length);
+        if (!line.empty() && line.back() == '\n')
+            line.remove_suffix(1);
+        line = trim_blanks(line);
+        if (line.empty() || line.front() == '#')
+            continue;
+
+        if (line.front() == '[') {
+            if (line == "[Default Applications]")
+                group = &list.defaults;
+            else if (line == "[Added Associations]")
+                group = &list.added;
+            else if (line == "[Removed Associations]")
+                group = &list.removed;
+            else
+                group = nullptr;
+            continue;
+        }
+        if (!group)
+            continue;
+
+        auto equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            SPDLOG_WARN("Malformed line in '{}': {}", path, line);
+            continue;
+        }
+        std::string mime_type(trim_blanks(line.substr(0, equals)));
+        stringlist_t &IDs = (*group)[mime_type];
+        for (const std::string &ID :
+             split((std::string)trim_blanks(line.substr(equals + 1)), ';')) {
+            if (!ID.empty())
+                IDs.push_back(ID);
+        }
+    }
+}
+
+std::string MimeApps::get_default_app(const std::string &mime_type,
+                                      const AppManager &appm) const {
+    for (const MimeAppsList &list : this->lists) {
+        auto iter = list.defaults.find(mime_type);
+        if (iter == list.defaults.end())
+            continue;
+        for (const std::string &ID : iter->second) {
+            if (appm.lookup_by_ID(ID))
+                return ID;
+        }
+    }
+
+    stringlist_t associated = get_associated_apps(mime_type, appm);
+    if (associated.empty())
+        return {};
+    return associated.front();
+}
+
+stringlist_t MimeApps::get_associated_apps(const std::string &mime_type,
+                                           const AppManager &appm) const {
+    stringlist_t result;
+    std::unordered_set<std::string> seen;
+    std::unordered_set<std::string> removed;
+
+    auto add = [&](const std::string &ID) {
+        if (removed.count(ID) != 0 || !appm.lookup_by_ID(ID))
+            return;
+        if (seen.insert(ID).second)
+            result.push_back(ID);
+    };
+
+    for (const MimeAppsList &list : this->lists) {
+        auto iter = list.added.find(mime_type);
+        if (iter != list.added.end()) {
+            for (const std::string &ID : iter->second)
+                add(ID);
+        }
+        // Removed Associations affect only files of lower precedence.
+        iter = list.removed.find(mime_type);
+        if (iter != list.removed.end())
+            removed.insert(iter->second.begin(), iter->second.end());
+    }
+    for (const std::string &ID : appm.lookup_by_mime_type(mime_type))
+        add(ID);
+
+    return result;
+}
+
+bool MimeApps::is_outdated() const {
+    return ::is_outdated(this->watched_paths);
+}
+
+stringlist_t MimeApps::get_files(const stringlist_t &desktop_names) {
+    std::string home = get_variable("HOME");
+
+    auto get_dirs = [&home](const char *home_var, const char *home_default,
+                            const char *dirs_var, const char *dirs_default,
+                            const char *subdir) {
+        stringlist_t result;
+        auto add_dir = [&result, subdir](std::string dir) {
+            if (dir.empty())
+                return;
+            if (dir.back() != '/')
+                dir += '/';
+            result.push_back(dir + subdir);
+        };
+        std::string dir = get_variable(home_var);
+        if (dir.empty() && !home.empty())
+            dir = home + home_default;
+        add_dir(std::move(dir));
+        std::string dirs = get_variable(dirs_var);
+        if (dirs.empty())
+            dirs = dirs_default;
+        for (std::string &path : split(dirs, ':'))
+            add_dir(std::move(path));
+        return result;
+    };
+
+    stringlist_t dirs = get_dirs("XDG_CONFIG_HOME", "/.config",
+                                 "XDG_CONFIG_DIRS", "/etc/xdg", "");
+    stringlist_t data_dirs =
+        get_dirs("XDG_DATA_HOME", "/.local/share", "XDG_DATA_DIRS",
+                 "/usr/local/share/:/usr/share/", "applications/");
+    dirs.insert(dirs.end(), data_dirs.begin(), data_dirs.end());
+
+    stringlist_t result;
+    for (const std::string &dir : dirs) {
+        for (const std::string &desktop : desktop_names)
+            result.push_back(dir + desktop + "-mimeapps.list");
+        result.push_back(dir + "mimeapps.list");
+    }
+    return result;
+}
@@ -0,0 +1,87 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef MIMEAPPS_DEF
+#define MIMEAPPS_DEF
+
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "AppManager.hh"
+#include "Utilities.hh"
+
+/*
+ * This class chooses apps for MIME types according to the MIME Applications
+ * Associations Specification. It reads mimeapps.list files, the MimeType keys
+ * of desktop files are provided by AppManager (see
+ * AppManager::lookup_by_mime_type()).
+ *
+ * The preferred app is the first installed app listed in Default Applications
+ * of the mimeapps.list files (in order of precedence). If there is none, the
+ * first associated app is used. Associated apps are apps listed in Added
+ * Associations followed by apps which list the MIME type in their desktop
+ * file (in order of rank). Apps listed in Removed Associations of a file
+ * aren't associated by files of lower precedence nor by desktop files.
+ */
+class MimeApps
+{
+public:
+    // files are mimeapps.list files in order of precedence. They don't have
+    // to exist.
+    explicit MimeApps(stringlist_t files);
+
+    // Return the desktop ID of the preferred app for mime_type or an empty
+    // string if there is no app which can handle it.
+    std::string get_default_app(const std::string &mime_type,
+                                const AppManager &appm) const;
+
+    // Return desktop IDs of associated apps, the most preferred one first.
+    stringlist_t get_associated_apps(const std::string &mime_type,
+                                     const AppManager &appm) const;
+
+    // Return true if any of the files has changed since it has been read.
+    bool is_outdated() const;
+
+    // Return mimeapps.list files from $XDG_CONFIG_HOME, $XDG_CONFIG_DIRS,
+    // $XDG_DATA_HOME/applications and $XDG_DATA_DIRS/applications in order
+    // of precedence. Desktop specific files (<desktop>-mimeapps.list) precede
+    // the generic ones in each directory.
+    static stringlist_t get_files(const stringlist_t &desktop_names);
+
+private:
+    using association_map =
+        std::unordered_map<std::string /* MIME type */,
+                           stringlist_t /* desktop IDs */>;
+
+    struct MimeAppsList
+    {
+        association_map defaults;
+        association_map added;
+        association_map removed;
+    };
+
+    void read_file(const std::string &path);
+
+    std::vector<MimeAppsList> lists;
+    std::vector<WatchedPath> watched_paths;
+};
+
+static_assert(std::is_move_constructible_v<MimeApps>);
+
+#endif
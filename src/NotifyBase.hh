@@ -21,6 +21,8 @@
 #include <string>
 #include <vector>
 
+class StateWriter;
+
 class NotifyBase
 {
 public:
@@ -47,5 +49,24 @@ public:
     // FileChange has absolute paths (they are relative to search_path
     // specified in ctor; search_path is absolute so this must be too).
     virtual std::vector<FileChange> getchanges() = 0;
+
+    // Some implementations don't register all their watches in the
+    // constructor to make the daemon ready sooner. While has_pending_watches()
+    // returns true, register_pending_watches() should be called whenever
+    // j4dd is idle. It registers some of the remaining watches and returns
+    // changes which have happened in the newly watched directories before
+    // they were watched.
+    virtual bool has_pending_watches() const {
+        return false;
+    }
+    virtual std::vector<FileChange> register_pending_watches() {
+        return {};
+    }
+
+    // Save state for StateHandoff. Returns false if the implementation doesn't
+    // support it.
+    virtual bool save_state(StateWriter &) const {
+        return false;
+    }
 };
 #endif
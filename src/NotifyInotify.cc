@@ -17,45 +17,234 @@
 
 #include "NotifyInotify.hh"
 
+#include <spdlog/spdlog.h>
+
+#include <dirent.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/inotify.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utility>
 
-#include "FileFinder.hh"
-
 NotifyInotify::directory_entry::directory_entry(int r, std::string p)
     : rank(r), path(std::move(p)) {}
 
-NotifyInotify::NotifyInotify(const stringlist_t &search_path) {
+// Number of directories watched by a single call to register_pending_watches().
+// Reading a directory and adding a watch takes a few microseconds, this keeps
+// the daemon responsive.
+#define WATCH_BATCH_SIZE 32
+// Number of directory entries resynced by a single call to
+// register_pending_watches(). Each of them may need a stat() and may produce a
+// change which has to be parsed by AppManager. Large directories are read over
+// several calls.
+#define RESYNC_BATCH_SIZE 256
+
+NotifyInotify::NotifyInotify(const stringlist_t &search_path,
+                             const std::vector<stringlist_t> &known_files,
+                             time_t scan_start)
+    : search_path(search_path), known_files(search_path.size()),
+      scan_start(scan_start) {
     inotifyfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (inotifyfd == -1)
         PFATALE("inotify_init");
 
-    for (int i = 0; i < (int)search_path.size();
-         i++) // size() is converted to int to silent warnings about
-              // narrowing when adding i to directories
-    {
-        int wd = inotify_add_watch(inotifyfd, search_path[i].c_str(),
-                                   IN_DELETE | IN_MODIFY | IN_MOVE);
-        if (wd == -1)
+    for (int i = (int)search_path.size() - 1; i >= 0; --i)
+        pending.emplace_back(i, std::string());
+
+    for (int i = 0; i < (int)search_path.size() && i < (int)known_files.size();
+         ++i) {
+        const std::string &base = search_path[i];
+        for (const std::string &file : known_files[i]) {
+            // Paths are absolute.
+            auto slash = file.rfind('/');
+            if (!startswith(file, base) || slash < base.size() - 1)
+                continue;
+            this->known_files[i][file.substr(base.size(),
+                                             slash + 1 - base.size())]
+                .insert(file.substr(slash + 1));
+        }
+    }
+}
+
+NotifyInotify::directory_reader::directory_reader(directory_entry dir,
+                                                 DIR *handle)
+    : dir(std::move(dir)), handle(handle, closedir) {}
+
+bool NotifyInotify::start_reading(const directory_entry &dir) {
+    std::string path = search_path[dir.rank] + dir.path;
+    bool is_root = dir.path.empty();
+
+    // The watch has to be added before the directory is read. Changes made
+    // after that will be reported by inotify, changes made before that
+    // will be found by the resync in read_directory(). Some may be reported
+    // by both, that is harmless.
+    int wd = inotify_add_watch(inotifyfd, path.c_str(),
+                               is_root ? IN_DELETE | IN_MODIFY | IN_MOVE
+                                       : IN_DELETE | IN_MODIFY);
+    if (wd == -1) {
+        if (is_root)
             PFATALE("inotify_add_watch");
-        directories.insert({
-            wd, {i, {}}
-        });
-        FileFinder find(search_path[i]);
-        while (++find) {
-            if (!find.isdir())
+        SPDLOG_WARN("Couldn't watch directory '{}': {}", path,
+                    strerror(errno));
+        return false;
+    }
+    directories.insert({wd, dir});
+
+    DIR *d = opendir(path.c_str());
+    if (d == NULL) {
+        SPDLOG_WARN("Couldn't read directory '{}': {}", path, strerror(errno));
+        return false;
+    }
+    directory_reader &reader = reading.emplace(dir, d);
+
+    if (!known_files.empty()) {
+        // Every directory is read only once, the set can be moved.
+        auto iter = known_files[dir.rank].find(dir.path);
+        if (iter != known_files[dir.rank].end())
+            reader.known = std::move(iter->second);
+    }
+    return true;
+}
+
+size_t NotifyInotify::read_directory(size_t max_entries,
+                                     std::vector<FileChange> &changes) {
+    directory_reader &reader = *reading;
+    const directory_entry &dir = reader.dir;
+    std::string path = search_path[dir.rank] + dir.path;
+
+    bool resync = !known_files.empty();
+    // Timestamps of files may be slightly older than the time returned by
+    // time() because of timestamp granularity. Resyncing a few extra files
+    // does no harm.
+    time_t threshold = scan_start - 1;
+
+    size_t count = 0;
+    for (; count < max_entries; ++count) {
+        dirent *entry = readdir(reader.handle.get());
+        if (entry == NULL)
+            break;
+        if (entry->d_name[0] == '.') {
+            // Exclude ., .. and hidden files
+            continue;
+        }
+        std::string name = entry->d_name;
+        std::string file_path = path + name;
+        if (is_directory_entry(entry, file_path)) {
+            pending.emplace_back(dir.rank, dir.path + name + '/');
+            continue;
+        }
+        if (!resync || !endswith(name, ".desktop"))
+            continue;
+
+        bool changed;
+        if (reader.known.count(name) == 0)
+            changed = true;
+        else {
+            ++reader.found_known;
+            // A file moved into the directory keeps its mtime but its ctime
+            // is updated.
+            struct stat st;
+            changed = stat(file_path.c_str(), &st) == 0 &&
+                      (st.st_mtime >= threshold || st.st_ctime >= threshold);
+        }
+        if (changed) {
+            SPDLOG_DEBUG("NotifyInotify: Resync: '{}' has changed.", file_path);
+            changes.emplace_back(dir.rank, dir.path + name,
+                                 changetype::modified);
+        }
+    }
+    // The rest of the directory will be read by the next call.
+    if (count == max_entries)
+        return count;
+
+    if (reader.found_known != reader.known.size()) {
+        for (const std::string &name : reader.known) {
+            std::string file_path = path + name;
+            if (access(file_path.c_str(), F_OK) == -1 && errno == ENOENT) {
+                SPDLOG_DEBUG("NotifyInotify: Resync: '{}' has been deleted.",
+                             file_path);
+                changes.emplace_back(dir.rank, dir.path + name,
+                                     changetype::deleted);
+            }
+        }
+    }
+    reading.reset();
+    return count;
+}
+
+bool NotifyInotify::has_pending_watches() const {
+    return !pending.empty() || reading;
+}
+
+std::vector<NotifyInotify::FileChange>
+NotifyInotify::register_pending_watches() {
+    std::vector<FileChange> changes;
+    size_t entries = 0;
+    int watched = 0;
+    while (entries < RESYNC_BATCH_SIZE) {
+        if (!reading) {
+            if (pending.empty() || watched == WATCH_BATCH_SIZE)
+                break;
+            directory_entry dir = std::move(pending.back());
+            pending.pop_back();
+            ++watched;
+            if (!start_reading(dir))
                 continue;
-            wd = inotify_add_watch(inotifyfd, find.path().c_str(),
-                                   IN_DELETE | IN_MODIFY);
+        }
+        entries += read_directory(RESYNC_BATCH_SIZE - entries, changes);
+    }
+    if (!has_pending_watches()) {
+        SPDLOG_DEBUG("NotifyInotify: All {} directories are watched.",
+                     directories.size());
+        // This is no longer needed.
+        known_files.clear();
+    }
+    return changes;
+}
+
+NotifyInotify::NotifyInotify(StateReader &state) {
+    // The inotify file descriptor is inherited from the previous process.
+    // Events which have happened while re-executing are still queued in it.
+    inotifyfd = state.read_fd();
+
+    try {
+        int64_t count = state.read_int();
+        if (count < 0)
+            throw state_error("Invalid number of inotify watches.");
+        for (int64_t i = 0; i < count; ++i) {
+            int wd = state.read_int();
+            int rank = state.read_int();
             directories.insert({
-                wd, {i, find.path().substr(search_path[i].length()) + '/'}
+                wd, {rank, state.read_string()}
             });
         }
+    } catch (const state_error &) {
+        close(inotifyfd);
+        throw;
+    }
+}
+
+NotifyInotify::~NotifyInotify() {
+    close(inotifyfd);
+}
+
+bool NotifyInotify::save_state(StateWriter &state) const {
+    if (has_pending_watches()) {
+        SPDLOG_INFO("NotifyInotify: Some directories aren't watched yet, "
+                    "state can't be saved.");
+        return false;
+    }
+    state.write_fd(inotifyfd);
+    state.write_int(directories.size());
+    for (const auto &[wd, dir] : directories) {
+        state.write_int(wd);
+        state.write_int(dir.rank);
+        state.write_string(dir.path);
     }
+    return true;
 }
 
 int NotifyInotify::getfd() const {
@@ -18,11 +18,18 @@
 #ifndef NOTIFYINOTIFY_DEV
 #define NOTIFYINOTIFY_DEV
 
+#include <dirent.h>
+#include <memory>
+#include <optional>
+#include <stddef.h>
 #include <string>
+#include <time.h>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "NotifyBase.hh"
+#include "StateHandoff.hh"
 #include "Utilities.hh"
 
 class NotifyInotify final : public NotifyBase
@@ -41,13 +48,64 @@ private:
 
     std::unordered_map<int /* watch descriptor */, directory_entry> directories;
 
+    stringlist_t search_path;
+
+    // Directories which haven't been watched yet.
+    std::vector<directory_entry> pending;
+
+    // Desktop files which have been found when the search path was scanned.
+    // They are indexed by rank and by the intermediate path of their
+    // directory. This is used to find changes which have happened before the
+    // directory was watched. It is empty if no resync is needed.
+    std::vector<
+        std::unordered_map<std::string, std::unordered_set<std::string>>>
+        known_files;
+    time_t scan_start = 0;
+
+    // Directory which is being read by register_pending_watches(). Large
+    // directories are read over several calls.
+    struct directory_reader
+    {
+        directory_entry dir;
+        std::unique_ptr<DIR, int (*)(DIR *)> handle;
+        // Desktop files of this directory taken from known_files.
+        std::unordered_set<std::string> known;
+        size_t found_known = 0;
+
+        directory_reader(directory_entry dir, DIR *handle);
+    };
+    std::optional<directory_reader> reading;
+
+    // Watch a directory and open it for read_directory(). Returns false if the
+    // directory couldn't be watched or read.
+    bool start_reading(const directory_entry &dir);
+    // Read at most max_entries entries of the directory being read and queue
+    // its subdirectories. If resync is enabled, changes which happened since
+    // scan_start are added to changes. reading is reset when the whole
+    // directory has been read. Returns the number of entries read.
+    size_t read_directory(size_t max_entries,
+                          std::vector<FileChange> &changes);
+
 public:
-    NotifyInotify(const stringlist_t &search_path);
+    // Watch the search path later (see
+    // NotifyBase::register_pending_watches()). known_files
+    // contains absolute paths of desktop files of each rank which were found
+    // by scanning the search path at time scan_start.
+    NotifyInotify(const stringlist_t &search_path,
+                  const std::vector<stringlist_t> &known_files,
+                  time_t scan_start);
+    // Restore state saved by save_state(). This throws state_error.
+    NotifyInotify(StateReader &state);
+    ~NotifyInotify();
 
     NotifyInotify(const NotifyInotify &) = delete;
     void operator=(const NotifyInotify &) = delete;
 
     int getfd() const;
     std::vector<FileChange> getchanges();
+    bool has_pending_watches() const override;
+    std::vector<FileChange> register_pending_watches() override;
+    // State can't be saved while some watches are pending.
+    bool save_state(StateWriter &state) const override;
 };
 #endif
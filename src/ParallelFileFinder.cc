@@ -0,0 +1,241 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "ParallelFileFinder.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <dirent.h>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+class DirectoryTraversal
+{
+public:
+    DirectoryTraversal(
+        const std::string &suffix, unsigned int thread_count,
+        const ParallelFileFinder::directory_callback &on_directory)
+        : suffix(suffix), on_directory(on_directory) {
+        for (unsigned int i = 0; i < thread_count; ++i)
+            this->workers.push_back(std::make_unique<Worker>());
+    }
+
+    stringlist_t run(const std::string &base_path) {
+        push(0, base_path);
+
+        // Most directories in the search path don't have any subdirectories.
+        // Spawning threads for them would be a waste of time.
+        std::string task;
+        if (take(0, task)) {
+            process_task(0, task);
+            finish_task();
+        }
+
+        std::vector<std::thread> threads;
+        if (has_pending_tasks()) {
+            for (unsigned int i = 1; i < this->workers.size(); ++i) {
+                try {
+                    threads.emplace_back(&DirectoryTraversal::work, this, i);
+                } catch (const std::system_error &e) {
+                    // Threads are only an optimization.
+                    SPDLOG_WARN("ParallelFileFinder: Couldn't create thread: "
+                                "{}",
+                                e.what());
+                    break;
+                }
+            }
+            work(0);
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        if (this->error)
+            std::rethrow_exception(this->error);
+
+        stringlist_t result;
+        for (const auto &worker : this->workers)
+            result.insert(result.end(),
+                          std::make_move_iterator(worker->files.begin()),
+                          std::make_move_iterator(worker->files.end()));
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    struct Worker
+    {
+        // This protects tasks. files are accessed only by the owning thread
+        // (and by run() after all threads have been joined).
+        std::mutex mutex;
+        std::deque<std::string> tasks;
+        stringlist_t files;
+    };
+
+    void push(unsigned int id, std::string task) {
+        {
+            std::lock_guard lock(this->workers[id]->mutex);
+            this->workers[id]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard lock(this->state_mutex);
+            ++this->pending;
+            ++this->queued;
+        }
+        this->state_cv.notify_one();
+    }
+
+    // Take a task from the back of our deque or steal one from the front of
+    // another deque.
+    bool take(unsigned int id, std::string &task) {
+        bool found = false;
+        {
+            Worker &own = *this->workers[id];
+            std::lock_guard lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                found = true;
+            }
+        }
+        for (unsigned int i = 1; !found && i < this->workers.size(); ++i) {
+            Worker &victim = *this->workers[(id + i) % this->workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                found = true;
+            }
+        }
+        if (found) {
+            std::lock_guard lock(this->state_mutex);
+            --this->queued;
+        }
+        return found;
+    }
+
+    void finish_task() {
+        bool done;
+        {
+            std::lock_guard lock(this->state_mutex);
+            done = --this->pending == 0;
+        }
+        if (done)
+            this->state_cv.notify_all();
+    }
+
+    bool has_pending_tasks() {
+        std::lock_guard lock(this->state_mutex);
+        return this->pending != 0;
+    }
+
+    void work(unsigned int id) {
+        std::string task;
+        while (true) {
+            if (!take(id, task)) {
+                std::unique_lock lock(this->state_mutex);
+                this->state_cv.wait(lock, [this]() {
+                    return this->queued != 0 || this->pending == 0;
+                });
+                if (this->pending == 0)
+                    return;
+                continue;
+            }
+            process_task(id, task);
+            finish_task();
+        }
+    }
+
+    void process_task(unsigned int id, const std::string &directory) {
+        try {
+            read_directory(id, directory);
+        } catch (...) {
+            std::lock_guard lock(this->state_mutex);
+            if (!this->error)
+                this->error = std::current_exception();
+        }
+    }
+
+    void read_directory(unsigned int id, const std::string &directory) {
+        if (this->on_directory) {
+            std::lock_guard lock(this->callback_mutex);
+            this->on_directory(directory);
+        }
+
+        DIR *dir = opendir(directory.c_str());
+        if (!dir)
+            throw std::runtime_error(directory + ": opendir() failed");
+        OnExit close_dir = [dir]() { closedir(dir); };
+
+        Worker &worker = *this->workers[id];
+        dirent *entry;
+        while ((entry = readdir(dir))) {
+            if (entry->d_name[0] == '.') {
+                // Exclude ., .. and hidden files
+                continue;
+            }
+            std::string path = directory + entry->d_name;
+            if (is_directory_entry(entry, path))
+                push(id, path + '/');
+            else if (endswith(path, this->suffix))
+                worker.files.push_back(std::move(path));
+        }
+    }
+
+    const std::string &suffix;
+    const ParallelFileFinder::directory_callback &on_directory;
+    std::mutex callback_mutex;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // This protects pending, queued and error.
+    std::mutex state_mutex;
+    std::condition_variable state_cv;
+    // Number of tasks which haven't been finished yet.
+    size_t pending = 0;
+    // Number of tasks which are waiting in deques.
+    size_t queued = 0;
+    std::exception_ptr error;
+};
+}; // namespace
+
+stringlist_t ParallelFileFinder::find(const std::string &base_path,
+                                      const std::string &suffix,
+                                      unsigned int thread_count,
+                                      const directory_callback &on_directory) {
+    if (thread_count == 0)
+        thread_count = 1;
+    DirectoryTraversal traversal(suffix, thread_count, on_directory);
+    return traversal.run(base_path);
+}
+
+unsigned int ParallelFileFinder::get_default_thread_count() {
+    // Traversal is mostly bound by the kernel, there is little benefit in
+    // using many threads.
+    return std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+}
@@ -0,0 +1,67 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PARALLELFILEFINDER_DEF
+#define PARALLELFILEFINDER_DEF
+
+#include <functional>
+#include <string>
+
+#include "Utilities.hh"
+
+/*
+ * ParallelFileFinder walks a directory tree using multiple threads. It is used
+ * to collect desktop files of a single rank of the search path. Some ranks
+ * (Flatpak exports, Nix profiles...) contain thousands of files spread across
+ * many nested directories.
+ *
+ * Each directory is a task. Each thread has its own deque of tasks. Newly found
+ * subdirectories are pushed to the back of the deque of the thread which found
+ * them and the thread takes its next task from the back too (depth-first). Idle
+ * threads steal tasks from the front of other threads' deques, which contains
+ * the oldest and therefore probably the largest subtrees.
+ *
+ * The order in which directories are read isn't deterministic, but the result
+ * is always sorted.
+ */
+namespace ParallelFileFinder
+{
+using directory_callback = std::function<void(const std::string &)>;
+
+// Return absolute paths of all files in base_path and its subdirectories whose
+// names end with suffix. base_path must end with '/'. Hidden files and
+// directories are skipped. The result is sorted.
+//
+// If on_directory is set, it is called for every directory (including
+// base_path) before the directory is read. Calls to it are serialized, but
+// they can be made from any thread.
+//
+// If a directory can't be read (std::runtime_error is thrown then) or if
+// on_directory throws, the first exception is rethrown after all other
+// directories have been traversed.
+//
+// No threads are spawned if thread_count is 1 or if base_path doesn't have
+// any subdirectories.
+stringlist_t find(const std::string &base_path, const std::string &suffix,
+                  unsigned int thread_count,
+                  const directory_callback &on_directory = {});
+
+// Return the number of threads find() should use.
+unsigned int get_default_thread_count();
+}; // namespace ParallelFileFinder
+
+#endif
@@ -0,0 +1,48 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef PARSINGLIMITS_DEF
+#define PARSINGLIMITS_DEF
+
+#include <stddef.h>
+
+// $XDG_DATA_HOME/applications is writable by the user and everything that
+// appears there is parsed (repeatedly in --wait-on mode). These limits make
+// sure that a single pathological desktop file can't make j4dd consume
+// unbounded amounts of memory or time. Desktop files which exceed them are
+// skipped (see limit_error in Application.hh).
+//
+// Zero disables a limit.
+struct ParsingLimits
+{
+    // Maximum size of a desktop file in bytes. Desktop files are read into
+    // memory as a whole.
+    size_t max_file_size = 1024 * 1024;
+    // Maximum length of a single line in bytes (including the newline).
+    size_t max_line_length = 64 * 1024;
+    // Maximum number of keys in a single group.
+    size_t max_keys_per_group = 10000;
+    // Maximum time spent parsing a single desktop file in milliseconds.
+    unsigned long parse_time_budget = 500;
+
+    void disable() {
+        max_file_size = max_line_length = max_keys_per_group = 0;
+        parse_time_budget = 0;
+    }
+};
+
+#endif
@@ -19,14 +19,18 @@
 
 // IWYU pragma: no_include <vector>
 
-static void add_applications_dir(std::string &str) {
+static void add_subdir(std::string &str, const std::string &subdir) {
     if (str.back() == '/') // fix double slashes
         str.pop_back();
-    if (!endswith(str, "/applications"))
-        str += "/applications";
+    if (!endswith(str, subdir))
+        str += subdir;
     str += '/';
 }
 
+static void add_applications_dir(std::string &str) {
+    add_subdir(str, "/applications");
+}
+
 stringlist_t build_search_path(std::string xdg_data_home, std::string home,
                                std::string xdg_data_dirs,
                                bool (*is_directory_func)(const std::string &)) {
@@ -57,3 +61,37 @@ stringlist_t get_search_path() {
                              get_variable("HOME"),
                              get_variable("XDG_DATA_DIRS"), is_directory);
 }
+
+stringlist_t build_autostart_search_path(
+    std::string xdg_config_home, std::string home, std::string xdg_config_dirs,
+    bool (*is_directory_func)(const std::string &)) {
+    stringlist_t result;
+
+    if (xdg_config_home.empty())
+        xdg_config_home = home + "/.config/";
+
+    add_subdir(xdg_config_home, "/autostart");
+    if (is_directory_func(xdg_config_home))
+        result.push_back(xdg_config_home);
+
+    if (xdg_config_dirs.empty())
+        xdg_config_dirs = "/etc/xdg/";
+
+    auto dirs = split(xdg_config_dirs, ':');
+    for (auto &path : dirs) {
+        if (path.empty())
+            continue;
+        add_subdir(path, "/autostart");
+        if (is_directory_func(path))
+            result.push_back(path);
+    }
+
+    return result;
+}
+
+stringlist_t get_autostart_search_path() {
+    return build_autostart_search_path(get_variable("XDG_CONFIG_HOME"),
+                                       get_variable("HOME"),
+                                       get_variable("XDG_CONFIG_DIRS"),
+                                       is_directory);
+}
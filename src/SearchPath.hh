@@ -29,4 +29,13 @@ stringlist_t build_search_path(std::string xdg_data_home, std::string home,
 
 stringlist_t get_search_path();
 
+// Return autostart directories as defined by the Desktop Application Autostart
+// Specification: $XDG_CONFIG_HOME/autostart followed by
+// $XDG_CONFIG_DIRS/autostart.
+stringlist_t build_autostart_search_path(
+    std::string xdg_config_home, std::string home, std::string xdg_config_dirs,
+    bool (*is_directory_func)(const std::string &));
+
+stringlist_t get_autostart_search_path();
+
 #endif
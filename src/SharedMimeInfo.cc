@@ -0,0 +1,251 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "SharedMimeInfo.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <ctype.h>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+
+#include "LineReader.hh"
+
+static std::string to_lower(std::string str) {
+    for (char &c : str)
+        c = tolower((unsigned char)c);
+    return str;
+}
+
+SharedMimeInfo::SharedMimeInfo(stringlist_t base_dirs) {
+    for (const std::string &dir : base_dirs) {
+        read_globs(dir + "globs2");
+        read_subclasses(dir + "subclasses");
+    }
+    SPDLOG_INFO("SharedMimeInfo: Read {} globs.",
+                this->literals.size() + this->suffixes.size() +
+                    this->patterns.size());
+}
+
+void SharedMimeInfo::read_lines(
+    const std::string &path,
+    const std::function<void(std::string_view)> &callback) {
+    this->watched_paths.emplace_back(path);
+    std::unique_ptr<FILE, fclose_deleter> file(fopen(path.c_str(), "r"));
+    if (!file) {
+        if (errno != ENOENT)
+            SPDLOG_WARN("Couldn't open '{}': {}", path, strerror(errno));
+        return;
+    }
+
+    LineReader liner;
+    ssize_t line_length;
+    while ((line_length = liner.getline(file.get())) != -1) {
+        std::string_view line(liner.get_lineptr(), line_length);
+        if (!line.empty() && line.back() == '\n')
+            line.remove_suffix(1);
+        if (line.empty() || line.front() == '#')
+            continue;
+        callback(line);
+    }
+}
+
+void SharedMimeInfo::read_globs(const std::string &path) {
+    // The format is weight:MIME type:glob[:flags]
+    read_lines(path, [this, &path](std::string_view line) {
+        auto first = line.find(':');
+        auto second = line.find(':', first + 1);
+        if (first == std::string_view::npos ||
+            second == std::string_view::npos) {
+            SPDLOG_WARN("Malformed line in '{}': {}", path, line);
+            return;
+        }
+        Glob glob;
+        glob.weight = atoi(std::string(line.substr(0, first)).c_str());
+        glob.mime_type = line.substr(first + 1, second - first - 1);
+        glob.order = this->literals.size() + this->suffixes.size() +
+                     this->patterns.size();
+        std::string_view pattern = line.substr(second + 1);
+        glob.case_sensitive = false;
+        auto flags = pattern.rfind(':');
+        if (flags != std::string_view::npos) {
+            glob.case_sensitive =
+                pattern.substr(flags + 1).find("cs") != std::string_view::npos;
+            pattern = pattern.substr(0, flags);
+        }
+        if (pattern.empty() || glob.mime_type == "__NOGLOBS__")
+            return;
+        glob.length = pattern.size();
+
+        std::string key(pattern);
+        if (!glob.case_sensitive)
+            key = to_lower(std::move(key));
+        auto wildcard = key.find_first_of("*?[");
+        if (wildcard == std::string::npos)
+            this->literals.emplace(std::move(key), std::move(glob));
+        else if (wildcard == 0 &&
+                 key.find_first_of("*?[", 1) == std::string::npos)
+            this->suffixes.emplace(key.substr(1), std::move(glob));
+        else
+            this->patterns.push_back({std::move(key), std::move(glob)});
+    });
+}
+
+void SharedMimeInfo::read_subclasses(const std::string &path) {
+    // The format is "child parent"
+    read_lines(path, [this, &path](std::string_view line) {
+        auto space = line.find(' ');
+        if (space == std::string_view::npos) {
+            SPDLOG_WARN("Malformed line in '{}': {}", path, line);
+            return;
+        }
+        this->parents.emplace(line.substr(0, space), line.substr(space + 1));
+    });
+}
+
+// Guess whether the file contains text by looking at its beginning.
+static bool looks_like_text(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd == -1)
+        return false;
+    OnExit close_fd = [fd]() { close(fd); };
+
+    unsigned char buf[256];
+    ssize_t size = read(fd, buf, sizeof buf);
+    if (size == -1)
+        return false;
+    for (ssize_t i = 0; i < size; ++i) {
+        if (buf[i] < 0x20 && !strchr("\t\n\r\f\b\x1b", buf[i]))
+            return false;
+    }
+    return true;
+}
+
+std::string SharedMimeInfo::get_mime_type(const std::string &path) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        return "inode/directory";
+
+    auto slash = path.rfind('/');
+    std::string name =
+        (slash == std::string::npos ? path : path.substr(slash + 1));
+    std::string lowercase_name = to_lower(name);
+
+    const Glob *best = nullptr;
+    auto consider = [&best](const Glob &glob) {
+        if (!best || glob.weight > best->weight ||
+            (glob.weight == best->weight &&
+             (glob.length > best->length ||
+              (glob.length == best->length && glob.order < best->order))))
+            best = &glob;
+    };
+    // Case sensitive globs are stored as is, case insensitive ones are
+    // lowercase. Case sensitive globs mustn't match the lowercase name.
+    auto lookup = [&](const std::unordered_multimap<std::string, Glob> &map,
+                      const std::string &key, bool is_lowercase) {
+        auto [begin, end] = map.equal_range(key);
+        for (auto iter = begin; iter != end; ++iter) {
+            if (!is_lowercase || !iter->second.case_sensitive)
+                consider(iter->second);
+        }
+    };
+
+    lookup(this->literals, name, false);
+    lookup(this->literals, lowercase_name, true);
+    for (size_t i = 0; i < name.size(); ++i) {
+        lookup(this->suffixes, name.substr(i), false);
+        lookup(this->suffixes, lowercase_name.substr(i), true);
+    }
+    for (const PatternGlob &pattern : this->patterns) {
+        const std::string &subject =
+            pattern.glob.case_sensitive ? name : lowercase_name;
+        if (fnmatch(pattern.pattern.c_str(), subject.c_str(), 0) == 0)
+            consider(pattern.glob);
+    }
+
+    if (best)
+        return best->mime_type;
+    return looks_like_text(path) ? "text/plain" : "application/octet-stream";
+}
+
+stringlist_t
+SharedMimeInfo::get_type_chain(const std::string &mime_type) const {
+    stringlist_t result;
+    std::unordered_set<std::string> seen;
+    std::deque<std::string> queue{mime_type};
+    while (!queue.empty()) {
+        std::string current = std::move(queue.front());
+        queue.pop_front();
+        if (!seen.insert(current).second)
+            continue;
+        auto [begin, end] = this->parents.equal_range(current);
+        for (auto iter = begin; iter != end; ++iter)
+            queue.push_back(iter->second);
+        result.push_back(std::move(current));
+    }
+
+    if (startswith(mime_type, "text/") && seen.count("text/plain") == 0)
+        result.push_back("text/plain");
+    // Directories and URL schemes aren't files.
+    if (!startswith(mime_type, "inode/") &&
+        !startswith(mime_type, "x-scheme-handler/") &&
+        seen.count("application/octet-stream") == 0)
+        result.push_back("application/octet-stream");
+    return result;
+}
+
+bool SharedMimeInfo::is_outdated() const {
+    return ::is_outdated(this->watched_paths);
+}
+
+stringlist_t SharedMimeInfo::get_base_dirs() {
+    stringlist_t result;
+
+    std::string xdg_data_home = get_variable("XDG_DATA_HOME");
+    if (xdg_data_home.empty()) {
+        std::string home = get_variable("HOME");
+        if (!home.empty())
+            xdg_data_home = home + "/.local/share";
+    }
+    if (!xdg_data_home.empty())
+        result.push_back(xdg_data_home + "/mime/");
+
+    std::string xdg_data_dirs = get_variable("XDG_DATA_DIRS");
+    if (xdg_data_dirs.empty())
+        xdg_data_dirs = "/usr/local/share/:/usr/share/";
+    for (std::string &path : split(xdg_data_dirs, ':')) {
+        if (path.empty())
+            continue;
+        if (path.back() != '/')
+            path += '/';
+        result.push_back(path + "mime/");
+    }
+
+    return result;
+}
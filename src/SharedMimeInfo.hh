@@ -0,0 +1,99 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SHAREDMIMEINFO_DEF
+#define SHAREDMIMEINFO_DEF
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Utilities.hh"
+
+/*
+ * This class determines MIME types of files using the globs2 and subclasses
+ * files of the Shared MIME-info Database (generated by update-mime-database).
+ *
+ * Only file names are matched, magic rules aren't used. Files which don't
+ * match any glob are recognized as text/plain if their beginning looks like
+ * text and as application/octet-stream otherwise. Aliases aren't resolved.
+ *
+ * Globs are indexed the way the specification suggests: literal names and
+ * simple suffixes (*.ext) are looked up in hash tables, only the remaining
+ * globs are matched one by one.
+ */
+class SharedMimeInfo
+{
+public:
+    // base_dirs must end with '/'. Earlier directories take precedence when
+    // globs of the same weight and length match.
+    explicit SharedMimeInfo(stringlist_t base_dirs);
+
+    // Return the MIME type of the file. The file doesn't have to exist, but
+    // only its name will be considered then.
+    std::string get_mime_type(const std::string &path) const;
+
+    // Return mime_type followed by all its parents (see subclasses). text/*
+    // types are subclasses of text/plain and all file types are subclasses of
+    // application/octet-stream.
+    stringlist_t get_type_chain(const std::string &mime_type) const;
+
+    // Return true if the database has changed since it has been read.
+    bool is_outdated() const;
+
+    // Return $XDG_DATA_HOME/mime and $XDG_DATA_DIRS/mime in this order.
+    static stringlist_t get_base_dirs();
+
+private:
+    struct Glob
+    {
+        std::string mime_type;
+        int weight;
+        size_t length;
+        // The position of the glob in the database, lower wins.
+        size_t order;
+        bool case_sensitive;
+    };
+
+    struct PatternGlob
+    {
+        std::string pattern;
+        Glob glob;
+    };
+
+    // Call callback for every line of the file which isn't empty or a
+    // comment. The file is added to watched_paths.
+    void read_lines(const std::string &path,
+                    const std::function<void(std::string_view)> &callback);
+    void read_globs(const std::string &path);
+    void read_subclasses(const std::string &path);
+
+    // Keys of case insensitive globs are lowercase.
+    std::unordered_multimap<std::string, Glob> literals;
+    std::unordered_multimap<std::string /* suffix */, Glob> suffixes;
+    std::vector<PatternGlob> patterns;
+    std::unordered_multimap<std::string /* child */, std::string /* parent */>
+        parents;
+    std::vector<WatchedPath> watched_paths;
+};
+
+static_assert(std::is_move_constructible_v<SharedMimeInfo>);
+
+#endif
@@ -0,0 +1,271 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "StateHandoff.hh"
+
+#include <spdlog/spdlog.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include "Utilities.hh"
+
+#define STATE_MAGIC "j4dd state\n"
+#define STATE_MAGIC_LENGTH 11
+// This must be incremented on every change of the payload. The payload is
+// written by do_wait_on(), AppManager::save_state() and
+// NotifyBase::save_state().
+#define STATE_FORMAT_VERSION 3
+#define STATE_ENV_VAR "J4DD_INHERITED_STATE_FD"
+// Sanity limit for the number of inherited file descriptors.
+#define STATE_MAX_FDS 64
+
+static void append_int(std::string &result, int64_t value) {
+    char buffer[sizeof value];
+    memcpy(buffer, &value, sizeof value);
+    result.append(buffer, sizeof buffer);
+}
+
+static int64_t extract_int(const std::string &data,
+                           std::string::size_type &pos) {
+    int64_t result;
+    if (data.size() - pos < sizeof result)
+        throw state_error("Unexpected end of state.");
+    memcpy(&result, data.data() + pos, sizeof result);
+    pos += sizeof result;
+    return result;
+}
+
+void StateWriter::write_int(int64_t value) {
+    append_int(this->payload, value);
+}
+
+void StateWriter::write_bool(bool value) {
+    this->payload += value ? '\1' : '\0';
+}
+
+void StateWriter::write_string(std::string_view value) {
+    append_int(this->payload, value.size());
+    this->payload += value;
+}
+
+void StateWriter::write_fd(int fd) {
+    write_int(this->fds.size());
+    this->fds.push_back(fd);
+}
+
+const std::string &StateWriter::get_payload() const {
+    return this->payload;
+}
+
+const std::vector<int> &StateWriter::get_fds() const {
+    return this->fds;
+}
+
+StateReader::StateReader(std::string payload, std::vector<int> fds)
+    : payload(std::move(payload)), fds(std::move(fds)),
+      taken_fds(this->fds.size(), false) {}
+
+int64_t StateReader::read_int() {
+    return extract_int(this->payload, this->pos);
+}
+
+bool StateReader::read_bool() {
+    if (this->pos == this->payload.size())
+        throw state_error("Unexpected end of state.");
+    char value = this->payload[this->pos++];
+    if (value != '\0' && value != '\1')
+        throw state_error("Invalid boolean in state.");
+    return value == '\1';
+}
+
+std::string StateReader::read_string() {
+    int64_t length = read_int();
+    if (length < 0 || (uint64_t)length > this->payload.size() - this->pos)
+        throw state_error("Invalid string length in state.");
+    std::string result = this->payload.substr(this->pos, length);
+    this->pos += length;
+    return result;
+}
+
+int StateReader::read_fd() {
+    int64_t index = read_int();
+    if (index < 0 || (uint64_t)index >= this->fds.size() ||
+        this->taken_fds[index])
+        throw state_error("Invalid file descriptor index in state.");
+    this->taken_fds[index] = true;
+    return this->fds[index];
+}
+
+void StateReader::close_fds() {
+    for (std::vector<int>::size_type i = 0; i < this->fds.size(); ++i) {
+        if (!this->taken_fds[i]) {
+            close(this->fds[i]);
+            this->taken_fds[i] = true;
+        }
+    }
+}
+
+static bool set_cloexec(int fd, bool cloexec) {
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1)
+        return false;
+    flags = cloexec ? flags | FD_CLOEXEC : flags & ~FD_CLOEXEC;
+    return fcntl(fd, F_SETFD, flags) != -1;
+}
+
+// Create a memfd containing state. -1 is returned on failure.
+static int create_state_fd(const StateWriter &state) {
+#ifdef MFD_CLOEXEC
+    std::string data = STATE_MAGIC;
+    append_int(data, STATE_FORMAT_VERSION);
+    append_int(data, state.get_fds().size());
+    for (int fd : state.get_fds())
+        append_int(data, fd);
+    data += state.get_payload();
+
+    // The memfd must be inherited, MFD_CLOEXEC is not set.
+    int memfd = memfd_create("j4dd-state", 0);
+    if (memfd == -1) {
+        SPDLOG_WARN("Couldn't create memfd for state handoff: {}",
+                    strerror(errno));
+        return -1;
+    }
+    if (writen(memfd, data.data(), data.size()) == -1) {
+        SPDLOG_WARN("Couldn't write state to memfd: {}", strerror(errno));
+        close(memfd);
+        return -1;
+    }
+    SPDLOG_DEBUG("Saved {} bytes of state.", data.size());
+    return memfd;
+#else
+    SPDLOG_WARN("State handoff isn't supported on this platform.");
+    return -1;
+#endif
+}
+
+void StateHandoff::reexec(char *const argv[], const StateWriter *state) {
+    int memfd = -1;
+    if (state != nullptr)
+        memfd = create_state_fd(*state);
+
+    if (memfd != -1) {
+        for (int fd : state->get_fds()) {
+            if (!set_cloexec(fd, false))
+                PFATALE("fcntl");
+        }
+        if (setenv(STATE_ENV_VAR, std::to_string(memfd).c_str(), 1) == -1)
+            PFATALE("setenv");
+    } else
+        SPDLOG_WARN("Desktop files will be read again after re-executing.");
+
+    SPDLOG_INFO("Executing '{}'.", argv[0]);
+    fflush(stdout);
+    spdlog::default_logger()->flush();
+
+    execvp(argv[0], argv);
+
+    SPDLOG_ERROR("Couldn't execute '{}': {}", argv[0], strerror(errno));
+
+    if (memfd != -1) {
+        unsetenv(STATE_ENV_VAR);
+        close(memfd);
+        for (int fd : state->get_fds())
+            set_cloexec(fd, true);
+    }
+}
+
+std::optional<StateReader> StateHandoff::take_inherited_state() {
+    const char *env = getenv(STATE_ENV_VAR);
+    if (env == NULL)
+        return {};
+
+    char *endptr;
+    errno = 0;
+    long memfd = strtol(env, &endptr, 10);
+    bool valid_fd = errno == 0 && *env != '\0' && *endptr == '\0' &&
+                    memfd >= 0 && memfd <= INT32_MAX;
+    // Child processes mustn't see this.
+    unsetenv(STATE_ENV_VAR);
+    if (!valid_fd) {
+        SPDLOG_WARN("Invalid $" STATE_ENV_VAR ", ignoring inherited state.");
+        return {};
+    }
+
+    std::string data;
+    {
+        OnExit close_memfd = [memfd]() { close(memfd); };
+        struct stat info;
+        if (fstat(memfd, &info) == -1) {
+            SPDLOG_WARN("Couldn't stat inherited state: {}", strerror(errno));
+            return {};
+        }
+        data.resize(info.st_size);
+        if (lseek(memfd, 0, SEEK_SET) == (off_t)-1 ||
+            readn(memfd, data.data(), data.size()) != (ssize_t)data.size()) {
+            SPDLOG_WARN("Couldn't read inherited state: {}", strerror(errno));
+            return {};
+        }
+    }
+
+    if (data.compare(0, STATE_MAGIC_LENGTH, STATE_MAGIC) != 0) {
+        SPDLOG_WARN("Inherited state is malformed, ignoring it.");
+        return {};
+    }
+
+    std::string::size_type pos = STATE_MAGIC_LENGTH;
+    int64_t version;
+    std::vector<int> fds;
+    try {
+        version = extract_int(data, pos);
+        int64_t fd_count = extract_int(data, pos);
+        if (fd_count < 0 || fd_count > STATE_MAX_FDS)
+            throw state_error("Invalid number of file descriptors.");
+        for (int64_t i = 0; i < fd_count; ++i) {
+            int64_t fd = extract_int(data, pos);
+            if (fd < 0 || fd > INT32_MAX)
+                throw state_error("Invalid file descriptor.");
+            fds.push_back(fd);
+            // Inherited file descriptors shouldn't leak to children.
+            set_cloexec(fd, true);
+        }
+    } catch (const state_error &e) {
+        for (int fd : fds)
+            close(fd);
+        SPDLOG_WARN("Inherited state is malformed, ignoring it: {}", e.what());
+        return {};
+    }
+
+    StateReader result(data.substr(pos), std::move(fds));
+
+    if (version != STATE_FORMAT_VERSION) {
+        SPDLOG_WARN("Inherited state has version {}, but version {} is "
+                    "required. Ignoring it.",
+                    version, STATE_FORMAT_VERSION);
+        result.close_fds();
+        return {};
+    }
+
+    return result;
+}
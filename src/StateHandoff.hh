@@ -0,0 +1,115 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef STATEHANDOFF_DEF
+#define STATEHANDOFF_DEF
+
+#include <optional>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * State handoff is used to re-execute j4-dmenu-desktop in --wait-on mode
+ * without having to read all desktop files again. The old process serializes
+ * its state into a memfd, executes the (possibly upgraded) binary and passes
+ * the memfd to it. The new process then restores its state from it.
+ *
+ * The state has the following format:
+ *
+ * "j4dd state\n"
+ * <format version>
+ * <number of inherited file descriptors> <file descriptors>...
+ * <payload>
+ *
+ * Everything except the payload must stay the same in all versions of
+ * j4-dmenu-desktop. This allows the new process to close all inherited file
+ * descriptors even when it doesn't understand the payload.
+ *
+ * Integers are stored in native byte order, strings are prefixed by their
+ * length. The state never leaves the machine it was created on, so the format
+ * doesn't have to be portable.
+ */
+
+// This exception is thrown when the inherited state is malformed or when it
+// can't be used.
+class state_error final : public std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+class StateWriter
+{
+public:
+    void write_int(int64_t value);
+    void write_bool(bool value);
+    void write_string(std::string_view value);
+    // The file descriptor will be inherited by the new process. Only its index
+    // is written to the payload, StateReader::read_fd() will translate it.
+    void write_fd(int fd);
+
+    const std::string &get_payload() const;
+    const std::vector<int> &get_fds() const;
+
+private:
+    std::string payload;
+    std::vector<int> fds;
+};
+
+class StateReader
+{
+public:
+    StateReader(std::string payload, std::vector<int> fds);
+
+    StateReader(StateReader &&) = default;
+    StateReader &operator=(StateReader &&) = default;
+    StateReader(const StateReader &) = delete;
+    void operator=(const StateReader &) = delete;
+
+    // These throw state_error when the payload is malformed.
+    int64_t read_int();
+    bool read_bool();
+    std::string read_string();
+    // The caller takes ownership of the returned file descriptor.
+    int read_fd();
+
+    // Close all inherited file descriptors which haven't been taken by
+    // read_fd(). This should be called when the state couldn't be restored.
+    void close_fds();
+
+private:
+    std::string payload;
+    std::string::size_type pos = 0;
+    std::vector<int> fds;
+    std::vector<bool> taken_fds;
+};
+
+namespace StateHandoff
+{
+// Execute argv[0] (it is searched in $PATH) and pass it the state. If state is
+// nullptr, the new process will start normally. This function returns only on
+// failure.
+void reexec(char *const argv[], const StateWriter *state);
+
+// Return the state passed by reexec() if there is one. This function should be
+// called early, it must be called before any child processes are spawned.
+std::optional<StateReader> take_inherited_state();
+}; // namespace StateHandoff
+
+#endif
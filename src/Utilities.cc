@@ -17,8 +17,13 @@
 
 #include "Utilities.hh"
 
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <iterator>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -96,6 +101,17 @@ bool is_directory(const std::string &path) {
     return S_ISDIR(filestat.st_mode);
 }
 
+bool is_directory_entry(const dirent *entry, const std::string &path) {
+#ifdef _DIRENT_HAVE_D_TYPE
+    if (entry->d_type == DT_DIR)
+        return true;
+    if (entry->d_type == DT_REG)
+        return false;
+#endif
+    // Symlinks are followed.
+    return is_directory(path);
+}
+
 std::string get_variable(const std::string &var) {
     const char *env = std::getenv(var.c_str());
     if (env) {
@@ -104,6 +120,166 @@ std::string get_variable(const std::string &var) {
         return "";
 }
 
+std::string get_cache_dir() {
+    std::string result = get_variable("XDG_CACHE_HOME");
+    // The spec says that relative paths should be ignored.
+    if (result.empty() || result.front() != '/') {
+        result = get_variable("HOME");
+        if (result.empty())
+            return {};
+        result += "/.cache";
+    }
+    if (mkdir(result.c_str(), 0700) == -1 && errno != EEXIST) {
+        SPDLOG_WARN("Couldn't create cache directory '{}': {}", result,
+                    strerror(errno));
+        return {};
+    }
+    result += "/j4-dmenu-desktop/";
+    if (mkdir(result.c_str(), 0700) == -1 && errno != EEXIST) {
+        SPDLOG_WARN("Couldn't create cache directory '{}': {}", result,
+                    strerror(errno));
+        return {};
+    }
+    return result;
+}
+
+bool write_cache_file(const std::string &path, const char *description,
+                      const std::function<void(FILE *)> &write_contents) {
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkstemp(temp_path.data());
+    if (fd == -1) {
+        SPDLOG_WARN("Couldn't create {} '{}': {}", description, path,
+                    strerror(errno));
+        return false;
+    }
+
+    std::unique_ptr<FILE, fclose_deleter> file(fdopen(fd, "w"));
+    if (!file) {
+        SPDLOG_WARN("Couldn't create {} '{}': {}", description, path,
+                    strerror(errno));
+        close(fd);
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    write_contents(file.get());
+
+    if (fflush(file.get()) == EOF || ferror(file.get())) {
+        SPDLOG_WARN("Couldn't write {} '{}': {}", description, path,
+                    strerror(errno));
+        unlink(temp_path.c_str());
+        return false;
+    }
+    file.reset();
+
+    if (rename(temp_path.c_str(), path.c_str()) == -1) {
+        SPDLOG_WARN("Couldn't save {} '{}': {}", description, path,
+                    strerror(errno));
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+timespec get_mtime(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1) {
+        timespec missing;
+        missing.tv_sec = -1;
+        missing.tv_nsec = 0;
+        return missing;
+    }
+    return st.st_mtim;
+}
+
+std::string get_url_scheme(std::string_view str) {
+    if (str.empty() || !isalpha((unsigned char)str.front()))
+        return {};
+    std::string result;
+    for (char c : str) {
+        if (c == ':')
+            return result;
+        if (!isalnum((unsigned char)c) && c != '+' && c != '-' && c != '.')
+            return {};
+        result += tolower((unsigned char)c);
+    }
+    return {};
+}
+
+std::string file_url_to_path(std::string_view url) {
+    if (get_url_scheme(url) != "file")
+        return {};
+    url.remove_prefix(5); // "file:"
+    if (!startswith(url, "//"))
+        return {};
+    url.remove_prefix(2);
+    if (startswith(url, "localhost/"))
+        url.remove_prefix(9); // "localhost"
+    if (!startswith(url, "/"))
+        return {};
+
+    auto hex_value = [](char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c = tolower((unsigned char)c);
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    };
+
+    std::string result;
+    for (size_t i = 0; i < url.size(); ++i) {
+        if (url[i] == '?' || url[i] == '#')
+            break;
+        if (url[i] != '%') {
+            result += url[i];
+            continue;
+        }
+        if (i + 2 >= url.size())
+            return {};
+        int high = hex_value(url[i + 1]), low = hex_value(url[i + 2]);
+        if (high == -1 || low == -1)
+            return {};
+        char decoded = high * 16 + low;
+        if (decoded == '\0')
+            return {};
+        result += decoded;
+        i += 2;
+    }
+    return result;
+}
+
+WatchedPath::WatchedPath(std::string path) : path(std::move(path)) {
+    struct stat st;
+    if (stat(this->path.c_str(), &st) == -1) {
+        this->mtime.tv_sec = -1;
+        this->mtime.tv_nsec = 0;
+        this->size = 0;
+    } else {
+        this->mtime = st.st_mtim;
+        this->size = st.st_size;
+    }
+}
+
+bool WatchedPath::exists() const {
+    return this->mtime.tv_sec != -1;
+}
+
+bool WatchedPath::has_changed() const {
+    WatchedPath current(this->path);
+    return current.mtime.tv_sec != this->mtime.tv_sec ||
+           current.mtime.tv_nsec != this->mtime.tv_nsec ||
+           current.size != this->size;
+}
+
+bool is_outdated(const std::vector<WatchedPath> &watched_paths) {
+    for (const WatchedPath &watched : watched_paths) {
+        if (watched.has_changed())
+            return true;
+    }
+    return false;
+}
+
 void fclose_deleter::operator()(FILE *f) const noexcept {
     fclose(f);
 }
@@ -22,13 +22,17 @@
 
 #include <cstdlib>
 #include <errno.h>
+#include <functional>
 #include <stdio.h>
 #include <string>
 #include <string_view>
 #include <sys/types.h>
+#include <time.h>
 #include <utility>
 #include <vector>
 
+struct dirent;
+
 #define PFATALE(msg)                                                           \
     {                                                                          \
         SPDLOG_ERROR("Failure occurred while calling " msg "(): {}",           \
@@ -46,7 +50,49 @@ void replace(std::string &str, const std::string &substr,
 bool endswith(const std::string &str, const std::string &suffix);
 bool startswith(std::string_view str, std::string_view prefix);
 bool is_directory(const std::string &path);
+// Return true if entry returned by readdir() is a directory. path is the path
+// of the entry. d_type is used when the filesystem provides it to save a
+// stat(), symlinks are followed otherwise.
+bool is_directory_entry(const dirent *entry, const std::string &path);
 std::string get_variable(const std::string &var);
+// Return path to j4-dmenu-desktop's directory in $XDG_CACHE_HOME (ending with
+// '/'). The directory is created if it doesn't exist. An empty string is
+// returned if it couldn't be created.
+std::string get_cache_dir();
+// Atomically replace the cache file at path. write_contents writes to
+// a temporary file which is renamed to path afterwards. Errors are logged,
+// description names the file in the messages (e.g. "menu cache").
+bool write_cache_file(const std::string &path, const char *description,
+                      const std::function<void(FILE *)> &write_contents);
+// Return mtime of path. tv_sec is set to -1 if it can't be stat()ed.
+timespec get_mtime(const std::string &path);
+
+// Path with its mtime and size at the time it has been stat()ed. This is used
+// to detect whether cached data derived from path has become outdated.
+// Nonexistent paths have mtime.tv_sec set to -1.
+struct WatchedPath
+{
+    std::string path;
+    timespec mtime;
+    off_t size;
+
+    // This stats path.
+    explicit WatchedPath(std::string path);
+
+    bool exists() const;
+    // Return true if path has been changed, created or removed since it has
+    // been stat()ed.
+    bool has_changed() const;
+};
+
+// Return true if any of the paths has changed.
+bool is_outdated(const std::vector<WatchedPath> &watched_paths);
+// Return the lowercased scheme of an URL (RFC 3986) or an empty string if str
+// doesn't begin with a scheme.
+std::string get_url_scheme(std::string_view str);
+// Convert a file:// URL to a path. An empty string is returned if the URL
+// doesn't refer to a local file or if it is malformed.
+std::string file_url_to_path(std::string_view url);
 ssize_t readn(int fd, void *buffer, size_t n);
 ssize_t writen(int fd, const void *buffer, size_t n);
 
@@ -31,10 +31,14 @@
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <functional>
 #include <getopt.h>
+#include <limits.h>
 #include <map>
 #include <memory>
 #include <optional>
@@ -48,6 +52,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <thread>
 #include <type_traits>
 #include <unistd.h>
 #include <unordered_set>
@@ -62,14 +67,21 @@
 #include "Dmenu.hh"
 #include "DynamicCompare.hh"
 #include "FieldCodes.hh"
-#include "FileFinder.hh"
 #include "Formatters.hh"
 #include "HistoryManager.hh"
 #include "I3Exec.hh"
+#include "IconLookup.hh"
+#include "LaunchRequest.hh"
 #include "LocaleSuffixes.hh"
+#include "MenuCache.hh"
+#include "MimeApps.hh"
 #include "NotifyBase.hh"
+#include "ParallelFileFinder.hh"
+#include "ParsingLimits.hh"
 #include "ParsingQuirks.hh"
 #include "SearchPath.hh"
+#include "SharedMimeInfo.hh"
+#include "StateHandoff.hh"
 #include "Utilities.hh"
 #include "version.hh"
 
@@ -136,6 +148,10 @@ static void print_usage(FILE *f) {
         "\nUsage:\n"
         "    j4-dmenu-desktop [--dmenu=\"dmenu -i\"] "
         "[--term=\"i3-sensible-terminal\"]\n"
+        "    j4-dmenu-desktop --wait-on=<path> --launch=<desktop ID> "
+        "[<file or URL>...]\n"
+        "    j4-dmenu-desktop --wait-on=<path> --open <file or URL>...\n"
+        "    j4-dmenu-desktop --autostart\n"
         "    j4-dmenu-desktop --help\n"
         "\nOptions:\n"
         "    -b, --display-binary\n"
@@ -161,11 +177,31 @@ static void print_usage(FILE *f) {
         "    --prune-bad-usage-log-entries\n"
         "        Remove names marked in usage log with no corresponding "
         "desktop files\n"
+        "    --icons\n"
+        "        Pass icons to dmenu using the extended dmenu protocol used by "
+        "rofi\n"
+        "    --icon-theme=<theme>\n"
+        "        Set the icon theme used by --icons (hicolor by default)\n"
+        "    --icon-size=<size>\n"
+        "        Set the preferred icon size used by --icons (48 by default)\n"
+        "    --menu-cache\n"
+        "        Show the menu from the previous run before reading desktop "
+        "files\n"
         "    -x, --use-xdg-de\n"
         "        Enables reading $XDG_CURRENT_DESKTOP to determine the desktop "
         "environment\n"
         "    --wait-on=<path>\n"
         "        Enable daemon mode\n"
+        "    --launch=<desktop ID>\n"
+        "        Ask the daemon listening on --wait-on to launch an app "
+        "without\n"
+        "        showing dmenu\n"
+        "    --open\n"
+        "        Ask the daemon listening on --wait-on to open files or URLs "
+        "with\n"
+        "        their preferred apps\n"
+        "    --autostart\n"
+        "        Launch XDG autostart entries instead of showing dmenu\n"
         "    --wrapper=<wrapper>\n"
         "        A wrapper binary.\n"
         "        Usage of '--wrapper \"i3 exec\"' and '--wrapper \"sway "
@@ -195,6 +231,10 @@ static void print_usage(FILE *f) {
         "    --strict-parsing\n"
         "        Enable strict desktop file parsing. Mutaly exclusive with\n"
         "        --desktop-file-compatibility.\n"
+        "    --parsing-limits=none | size=<bytes>,line=<bytes>,keys=<count>,"
+        "time=<ms>\n"
+        "        Skip desktop files which are too large or too slow to "
+        "parse\n"
         "    --version\n"
         "        Display program version\n"
         "    -h, --help\n"
@@ -218,20 +258,59 @@ static void print_usage(FILE *f) {
  */
 namespace SetupPhase
 {
-// This returns absolute paths.
-static Desktop_file_list collect_files(const stringlist_t &search_path) {
+// This returns absolute paths. If menu_cache isn't nullptr, all traversed
+// directories are registered in it.
+static Desktop_file_list collect_files(const stringlist_t &search_path,
+                                       MenuCache *menu_cache = nullptr) {
     Desktop_file_list result;
     result.reserve(search_path.size());
 
+    ParallelFileFinder::directory_callback on_directory;
+    if (menu_cache != nullptr) {
+        on_directory = [menu_cache](const std::string &path) {
+            menu_cache->watch(path);
+        };
+    }
+    unsigned int thread_count = ParallelFileFinder::get_default_thread_count();
+
     for (const string &base_path : search_path) {
-        std::vector<string> found_desktop_files;
-        FileFinder finder(base_path);
-        while (++finder) {
-            if (finder.isdir() || !endswith(finder.path(), ".desktop"))
-                continue;
-            found_desktop_files.push_back(finder.path());
+        // The result is sorted. This makes desktop file ID collision handling
+        // within a single rank deterministic.
+        result.emplace_back(base_path,
+                            ParallelFileFinder::find(base_path, ".desktop",
+                                                     thread_count,
+                                                     on_directory));
+    }
+
+    return result;
+}
+
+// Autostart directories aren't searched recursively, only files directly in
+// them are autostart entries.
+static Desktop_file_list
+collect_autostart_files(const stringlist_t &search_path) {
+    Desktop_file_list result;
+    result.reserve(search_path.size());
+
+    for (const string &base_path : search_path) {
+        std::vector<string> files;
+        DIR *dir = opendir(base_path.c_str());
+        if (dir == NULL) {
+            SPDLOG_WARN("Couldn't open autostart directory '{}': {}",
+                        base_path, strerror(errno));
+        } else {
+            OnExit close_dir = [dir]() { closedir(dir); };
+            errno = 0;
+            while (dirent *entry = readdir(dir)) {
+                if (endswith(entry->d_name, ".desktop"))
+                    files.push_back(base_path + entry->d_name);
+            }
+            if (errno != 0)
+                PFATALE("readdir");
+            // This makes the order of execution deterministic.
+            std::sort(files.begin(), files.end());
         }
-        result.emplace_back(base_path, std::move(found_desktop_files));
+        result.emplace_back(base_path, std::move(files));
     }
 
     return result;
@@ -270,6 +349,45 @@ count_collected_desktop_files(const Desktop_file_list &files) {
     return result;
 }
 
+// State inherited from a previous instance of j4dd (see StateHandoff.hh) can be
+// used only if both instances read desktop files the same way.
+static std::string get_state_fingerprint(const stringlist_t &search_path,
+                                         const stringlist_t &desktopenvs,
+                                         ParsingQuirks quirks,
+                                         const ParsingLimits &limits) {
+    std::string result = join(search_path, '\n');
+    result += '\0';
+    result += join(desktopenvs, '\n');
+    result += '\0';
+    // Other quirks do not affect AppManager.
+    result += quirks.extra_wine_escaping ? '1' : '0';
+    result += '\0';
+    result += fmt::format("{} {} {} {}", limits.max_file_size,
+                          limits.max_line_length, limits.max_keys_per_group,
+                          limits.parse_time_budget);
+    return result;
+}
+
+// The cached menu (see MenuCache.hh) can be used only if j4dd has been executed
+// the same way. All arguments are included in the key for simplicity.
+static std::string get_menu_cache_key(int argc, char **argv,
+                                      const stringlist_t &search_path) {
+    std::string result = version();
+    for (int i = 0; i < argc; ++i) {
+        result += '\0';
+        result += argv[i];
+    }
+    result += '\0';
+    result += join(search_path, '\n');
+    // Variables affecting LocaleSuffixes and -x.
+    for (const char *var :
+         {"LC_ALL", "LC_MESSAGES", "LANG", "XDG_CURRENT_DESKTOP"}) {
+        result += '\0';
+        result += get_variable(var);
+    }
+    return result;
+}
+
 // This class manager nape -> app mapping used for resolving user response
 // received by Dmenu.
 class NameToAppMapping
@@ -406,6 +524,10 @@ public:
         this->hist.remove_obsolete_entry(iter);
     }
 
+    const std::string &get_filename() const {
+        return this->hist.get_filename();
+    }
+
 private:
     HistoryManager hist;
     stringlist_t formatted_history;
@@ -447,17 +569,35 @@ public:
     }
 };
 
-static std::optional<std::string>
-do_dmenu(Dmenu &dmenu, const name_map &mapping, const stringlist_t &history) {
-    // Check for dmenu errors via SIGPIPE.
-    SIGPIPEHandler sig;
+// Append a single entry to menu. If icons are enabled, the icon is passed to
+// dmenu using the extended dmenu protocol used by rofi, fuzzel and wofi:
+// <name>\0icon\x1f<path to icon>
+static void append_entry(std::string &menu, std::string_view name,
+                         const Application &app, const IconLookup *icons) {
+    menu += name;
+    if (icons != nullptr) {
+        std::string_view icon_path = icons->lookup(app.icon);
+        if (!icon_path.empty()) {
+            menu += '\0';
+            menu += "icon\x1f";
+            menu += icon_path;
+        }
+    }
+    menu += '\n';
+}
 
-    // Transfer the names to dmenu
+// Return all entries which should be written to dmenu. Each entry is terminated
+// by a newline.
+static std::string render_menu(const name_map &mapping,
+                               const stringlist_t &history,
+                               const IconLookup *icons) {
+    std::string menu;
     if (!history.empty()) {
-        std::set<std::string_view, DynamicCompare> desktop_file_names(
-            mapping.key_comp());
-        for (const auto &[name, ignored] : mapping)
-            desktop_file_names.emplace_hint(desktop_file_names.end(), name);
+        std::map<std::string_view, const Application *, DynamicCompare>
+            desktop_file_names(mapping.key_comp());
+        for (const auto &[name, resolved] : mapping)
+            desktop_file_names.emplace_hint(desktop_file_names.end(), name,
+                                            resolved.app);
         for (const auto &name : history) {
             // We don't want to display a single element twice. We can't
             // print history and then desktop name list because names in
@@ -466,9 +606,11 @@ do_dmenu(Dmenu &dmenu, const name_map &mapping, const stringlist_t &history) {
             // mean that the desktop file corresponding to the history name
             // has been removed, making the history entry obsolete. The
             // history entry shouldn't be shown if that is the case.
-            if (desktop_file_names.erase(name))
-                dmenu.write(name);
-            else {
+            auto desktop_file_name = desktop_file_names.find(name);
+            if (desktop_file_name != desktop_file_names.end()) {
+                append_entry(menu, name, *desktop_file_name->second, icons);
+                desktop_file_names.erase(desktop_file_name);
+            } else {
                 // This shouldn't happen thanks to FormattedHistoryManager
                 SPDLOG_ERROR(
                     "A name in history isn't in name list when it should "
@@ -476,15 +618,43 @@ do_dmenu(Dmenu &dmenu, const name_map &mapping, const stringlist_t &history) {
                 abort();
             }
         }
-        for (const auto &name : desktop_file_names)
-            dmenu.write(name);
+        for (const auto &[name, app] : desktop_file_names)
+            append_entry(menu, name, *app, icons);
     } else {
-        for (const auto &[name, ignored] : mapping)
-            dmenu.write(name);
+        for (const auto &[name, resolved] : mapping)
+            append_entry(menu, name, *resolved.app, icons);
     }
+    return menu;
+}
 
+// Check whether name is one of the entries of a menu returned by
+// render_menu().
+static bool menu_contains(std::string_view menu, std::string_view name) {
+    while (!menu.empty()) {
+        auto newline = menu.find('\n');
+        std::string_view entry = menu.substr(0, newline);
+        // Strip the icon.
+        entry = entry.substr(0, entry.find('\0'));
+        if (entry == name)
+            return true;
+        if (newline == std::string_view::npos)
+            break;
+        menu.remove_prefix(newline + 1);
+    }
+    return false;
+}
+
+// Write the menu to dmenu and show it. This should be called only once per
+// dmenu invocation.
+static void show_menu(Dmenu &dmenu, std::string_view menu) {
+    // Check for dmenu errors via SIGPIPE.
+    SIGPIPEHandler sig;
+
+    dmenu.write_entries(menu);
     dmenu.display();
+}
 
+static std::optional<std::string> read_dmenu_choice(Dmenu &dmenu) {
     string choice = dmenu.read_choice(); // This blocks
     if (choice.empty())
         return {};
@@ -542,9 +712,13 @@ public:
     CommandRetrievalLoop(
         Dmenu dmenu, SetupPhase::NameToAppMapping mapping,
         std::optional<SetupPhase::FormattedHistoryManager> hist_manager,
-        bool no_exec)
+        std::optional<IconLookup> icons, bool no_exec,
+        std::optional<MenuCache> menu_cache = {},
+        std::optional<std::string> speculative_menu = {})
         : dmenu(std::move(dmenu)), mapping(std::move(mapping)),
-          hist_manager(std::move(hist_manager)), no_exec(no_exec) {}
+          hist_manager(std::move(hist_manager)), icons(std::move(icons)),
+          no_exec(no_exec), menu_cache(std::move(menu_cache)),
+          speculative_menu(std::move(speculative_menu)) {}
 
     // This class could be copied or moved, but it wouldn't make much sense in
     // current implementation. This prevents accidental copy/move.
@@ -556,10 +730,11 @@ public:
     struct DesktopCommandInfo
     {
         const Application *app;
-        std::string args; // Arguments provided to %f, %F, %u and %U field codes
-                          // in desktop files. This will be empty in most cases.
+        stringlist_t args; // Arguments provided to %f, %F, %u and %U field
+                           // codes in desktop files. This will be empty in
+                           // most cases.
 
-        DesktopCommandInfo(const Application *app, std::string args)
+        DesktopCommandInfo(const Application *app, stringlist_t args)
             : app(app), args(std::move(args)) {}
     };
 
@@ -580,17 +755,49 @@ public:
     // should be executed as soon as possible. It is executed in main() as part
     // of setup. In wait-on mode, it must be executed after each pipe
     // invocation. run_dmenu() is used only in wait-on mode in do_wait_on().
+    // The standby dmenu is used if it has been prepared.
     void run_dmenu() {
         this->dmenu.run();
     }
 
+    // Fork dmenu in advance and write the current menu to it (see
+    // Dmenu::prepare_standby()). This is used only in wait-on mode. It has to
+    // be called again whenever the menu changes.
+    void prepare_standby() {
+        this->dmenu.prepare_standby(render());
+    }
+
+    void discard_standby() {
+        this->dmenu.discard_standby();
+    }
+
     std::optional<CommandInfoVariant> prompt_user_for_choice() {
+        std::optional<std::string> speculative_menu =
+            std::move(this->speculative_menu);
+        this->speculative_menu.reset();
+        // menu is needed only for menu_cache. It may stay empty when the
+        // standby dmenu is used, menu_cache isn't used in wait-on mode.
+        std::string menu;
+        if (speculative_menu) {
+            // The cached menu has already been shown, it can't be replaced
+            // now.
+            menu = render();
+            if (*speculative_menu != menu)
+                SPDLOG_INFO("Cached menu is outdated, it will be updated.");
+        } else if (this->dmenu.is_prefilled()) {
+            // The menu has been written by prepare_standby(). display() writes
+            // the part which didn't fit into the pipe.
+            show_menu(this->dmenu, {});
+        } else {
+            menu = render();
+            show_menu(this->dmenu, menu);
+        }
+
         std::optional<std::string> query =
-            RunPhase::do_dmenu(this->dmenu, this->mapping.get_formatted_map(),
-                               (this->hist_manager ? this->hist_manager->view()
-                                                   : stringlist_t{})); // blocks
+            read_dmenu_choice(this->dmenu); // blocks
         if (!query) {
             SPDLOG_INFO("No application has been selected, exiting...");
+            save_menu_cache(menu);
             return {};
         }
 
@@ -605,19 +812,64 @@ public:
         else
             SPDLOG_DEBUG("Selected entry is: desktop app");
 
-        if (is_custom)
+        if (is_custom) {
+            save_menu_cache(menu);
+            // Don't execute the name of an app which doesn't exist anymore as
+            // a command.
+            if (speculative_menu && menu_contains(*speculative_menu, *query)) {
+                SPDLOG_ERROR("Selected app '{}' no longer exists!", *query);
+                exit(EXIT_FAILURE);
+            }
             return CommandInfoVariant(std::in_place_type_t<CustomCommandInfo>{},
                                       std::get<CommandLookup>(lookup).command);
-        else {
+        } else {
             const ApplicationLookup &appl = std::get<ApplicationLookup>(lookup);
             if (!this->no_exec && this->hist_manager) {
                 const std::string &name =
                     (appl.is_generic ? appl.app->generic_name : appl.app->name);
                 this->hist_manager->increment(name);
             }
+            if (this->menu_cache && this->hist_manager) {
+                // History has changed, the next menu will be different.
+                this->hist_manager->reload(this->mapping);
+                menu = render();
+            }
+            save_menu_cache(menu);
             return CommandInfoVariant(
                 std::in_place_type_t<DesktopCommandInfo>{}, appl.app,
-                appl.args);
+                split_user_arguments(appl.args));
+        }
+    }
+
+    // Handle a launch request received in wait-on mode (see LaunchRequest.hh).
+    // No dmenu is involved. History is updated like when the app has been
+    // selected in dmenu (apps with NoDisplay=true have no name in the menu, so
+    // they aren't recorded). Empty optional is returned when there's no app
+    // with the given desktop ID.
+    std::optional<CommandInfoVariant>
+    launch_by_ID(const AppManager &appm, LaunchRequest::Request request) {
+        auto app = appm.lookup_by_ID(request.desktop_id);
+        if (!app) {
+            SPDLOG_ERROR("Launch request: Couldn't find desktop ID '{}'!",
+                         request.desktop_id);
+            return {};
+        }
+        SPDLOG_INFO("Launch request: Launching '{}'.", request.desktop_id);
+        if (!this->no_exec && this->hist_manager && !app->get().no_display) {
+            this->hist_manager->increment(app->get().name);
+            this->hist_manager->reload(this->mapping);
+        }
+        return CommandInfoVariant(std::in_place_type_t<DesktopCommandInfo>{},
+                                  &app->get(), std::move(request.args));
+    }
+
+    // Rebuild the icon index if an icon theme has changed. This is used in
+    // wait-on mode, the menu must be rendered again afterwards.
+    void update_icons() {
+        if (this->icons && this->icons->is_outdated()) {
+            SPDLOG_INFO("Icon themes have changed, rebuilding the icon "
+                        "index.");
+            this->icons->rebuild();
         }
     }
 
@@ -628,15 +880,125 @@ public:
     }
 
 private:
+    // This must be called after history has been written.
+    void save_menu_cache(const std::string &menu) {
+        if (!this->menu_cache)
+            return;
+        if (this->hist_manager)
+            this->menu_cache->watch(this->hist_manager->get_filename());
+        this->menu_cache->save(menu);
+    }
+
+    std::string render() const {
+        return render_menu(this->mapping.get_formatted_map(),
+                           (this->hist_manager ? this->hist_manager->view()
+                                               : stringlist_t{}),
+                           (this->icons ? &*this->icons : nullptr));
+    }
+
     Dmenu dmenu;
     SetupPhase::NameToAppMapping mapping;
     std::optional<SetupPhase::FormattedHistoryManager> hist_manager;
+    std::optional<IconLookup> icons;
     bool no_exec;
+    // These are used only in one-shot mode.
+    std::optional<MenuCache> menu_cache;
+    // Menu shown from menu_cache before desktop files have been read.
+    std::optional<std::string> speculative_menu;
+};
+
+// This class handles open requests received in wait-on mode (see
+// LaunchRequest.hh). The Shared MIME-info Database and mimeapps.list files are
+// read when the first open request is received. They are reread when they
+// change. MimeType keys of desktop files are tracked by AppManager.
+class OpenRequestResolver
+{
+public:
+    // Desktop specific mimeapps.list files are looked up regardless of
+    // --use-xdg-de. Their names are lowercase.
+    OpenRequestResolver()
+        : desktop_names(split(get_variable("XDG_CURRENT_DESKTOP"), ':')) {
+        for (std::string &name : this->desktop_names) {
+            for (char &c : name)
+                c = tolower((unsigned char)c);
+        }
+    }
+
+    // Find the preferred app for a file or an URL. Empty optional is returned
+    // when there's no such app. target must be an URL or an absolute path.
+    std::optional<CommandRetrievalLoop::CommandInfoVariant>
+    resolve(const AppManager &appm, const std::string &target) {
+        using CommandInfoVariant = CommandRetrievalLoop::CommandInfoVariant;
+        using DesktopCommandInfo = CommandRetrievalLoop::DesktopCommandInfo;
+
+        std::string scheme = get_url_scheme(target);
+        stringlist_t mime_types;
+        // Local files are passed to apps as paths, because %f and %F accept
+        // only paths while %u and %U accept both.
+        std::string argument = target;
+        if (target.front() == '/' || scheme == "file") {
+            std::string path =
+                (scheme == "file" ? file_url_to_path(target) : target);
+            if (path.empty()) {
+                SPDLOG_ERROR("Open request: '{}' isn't a local file!", target);
+                return {};
+            }
+            if (!this->mime_info || this->mime_info->is_outdated())
+                this->mime_info.emplace(SharedMimeInfo::get_base_dirs());
+            mime_types = this->mime_info->get_type_chain(
+                this->mime_info->get_mime_type(path));
+            argument = std::move(path);
+        } else if (!scheme.empty()) {
+            mime_types.push_back("x-scheme-handler/" + scheme);
+        } else {
+            SPDLOG_ERROR(
+                "Open request: '{}' isn't an absolute path nor an URL!",
+                target);
+            return {};
+        }
+
+        if (!this->mime_apps || this->mime_apps->is_outdated())
+            this->mime_apps.emplace(MimeApps::get_files(this->desktop_names));
+
+        // Parent types are tried when there is no app for the type itself.
+        for (const std::string &mime_type : mime_types) {
+            std::string ID = this->mime_apps->get_default_app(mime_type, appm);
+            if (ID.empty())
+                continue;
+            SPDLOG_INFO("Open request: Opening '{}' ({}) with '{}'.", target,
+                        mime_type, ID);
+            return CommandInfoVariant(
+                std::in_place_type_t<DesktopCommandInfo>{},
+                &appm.lookup_by_ID(ID)->get(),
+                stringlist_t{std::move(argument)});
+        }
+        SPDLOG_ERROR("Open request: No app can open '{}' ({})!", target,
+                     mime_types.front());
+        return {};
+    }
+
+private:
+    stringlist_t desktop_names;
+    std::optional<MimeApps> mime_apps;
+    std::optional<SharedMimeInfo> mime_info;
 };
 }; // namespace RunPhase
 
 namespace ExecutePhase
 {
+// Child processes spawned by do_autostart() report failures through this pipe.
+// It is closed by a successful execve(). It is -1 otherwise.
+static int spawn_error_fd = -1;
+
+static void report_spawn_failure() {
+    if (spawn_error_fd == -1)
+        return;
+    char failure = 1;
+    if (write(spawn_error_fd, &failure, 1) == -1)
+        SPDLOG_ERROR("Couldn't report failure to the parent: {}",
+                     strerror(errno));
+}
+
 [[noreturn]] void execute_app(const stringlist_t &args) {
     std::string cmdline_string = CMDLineAssembly::convert_argv_to_string(args);
     SPDLOG_INFO("Executing command: {}", cmdline_string);
@@ -647,6 +1009,7 @@ namespace ExecutePhase
 #endif
     execvp(argv.front(), (char *const *)argv.data());
     SPDLOG_ERROR("Couldn't execute command: {}", cmdline_string);
+    report_spawn_failure();
     // this function can be called either directly, or in a fork used in
     // do_wait_on(). Theoretically exit() should be called instead of _exit() in
     // the first case, but it isn't that important.
@@ -736,6 +1099,7 @@ public:
                 if (chdir(path.c_str()) == -1) {
                     SPDLOG_ERROR("Couldn't chdir() to '{}' set in Path key: {}",
                                  path, strerror(errno));
+                    report_spawn_failure();
                     exit(EXIT_FAILURE);
                 }
             }
@@ -872,13 +1236,30 @@ private:
     CMDLineTerm::term_assembler term_assembler;
     ParsingQuirks quirks;
 };
+
+static std::unique_ptr<BaseExecutable>
+create_executor(bool no_exec, bool use_i3_ipc, std::string terminal,
+                std::string wrapper, const std::string &i3_ipc_path,
+                CMDLineTerm::term_assembler term_mode, ParsingQuirks quirks) {
+    if (no_exec)
+        return std::make_unique<FakeExecutable>(
+            std::move(terminal), std::move(wrapper), term_mode, quirks);
+    else if (use_i3_ipc)
+        return std::make_unique<I3Executable>(std::move(terminal), i3_ipc_path,
+                                              term_mode, quirks);
+    else
+        return std::make_unique<NormalExecutable>(
+            std::move(terminal), std::move(wrapper), term_mode, quirks);
+}
 }; // namespace ExecutePhase
 
 [[noreturn]] static void
 do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
            const stringlist_t &search_path,
            RunPhase::CommandRetrievalLoop &command_retrieve,
-           ExecutePhase::BaseExecutable *executor) {
+           ExecutePhase::BaseExecutable *executor, char *const argv[],
+           const std::string &state_fingerprint,
+           std::vector<pid_t> processes_to_wait_for) {
     // We need to determine if we're i3 to know if we need to fork before
     // executing a program.
     bool is_i3 =
@@ -887,10 +1268,13 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
     int local_sigchld_fd = -1;
 
     // Avoid zombie processes.
-    if (!is_i3)
+    if (!is_i3) {
         local_sigchld_fd = setup_sigchld_signal();
-
-    std::vector<pid_t> processes_to_wait_for;
+        // Processes inherited from the previous instance of j4dd (see 'r'
+        // below) might have already exited.
+        if (!processes_to_wait_for.empty())
+            sigchld(SIGCHLD);
+    }
 
     int fd;
     if (mkfifo(wait_on, 0600) && errno != EEXIST)
@@ -909,15 +1293,16 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
     // disregards it because of nfds (local_sigchld_fd is also set to -1, so
     // poll() would have ignored it anyway).
     int nfds = is_i3 ? 2 : 3;
-    while (1) {
-        watch[0].revents = watch[1].revents = watch[2].revents = 0;
-        int ret;
-        while ((ret = poll(watch, nfds, -1)) == -1 && errno == EINTR)
-            ;
-        if (ret == -1)
-            PFATALE("poll");
-        if (watch[1].revents & POLLIN) {
-            for (const auto &i : notify.getchanges()) {
+
+    // The number of skipped desktop files is reported at startup. Files which
+    // are added later are reported when the count changes.
+    unsigned long limit_exceeded_count = appm.get_limit_exceeded_count();
+
+    // Apply changes reported by notify.
+    auto handle_changes =
+        [&](const std::vector<NotifyBase::FileChange> &changes) {
+            bool menu_changed = false;
+            for (const auto &i : changes) {
                 if (!endswith(i.name, ".desktop"))
                     continue;
                 switch (i.status) {
@@ -933,26 +1318,82 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
                     // Shouldn't be reachable.
                     abort();
                 }
-                command_retrieve.update_mapping(appm);
+                menu_changed = true;
 #ifdef DEBUG
                 appm.check_inner_state();
 #endif
             }
+            // This is done once for all changes, there are usually many of
+            // them at once (a resync may report hundreds). Formatting the
+            // menu for each of them would be quadratic.
+            if (menu_changed) {
+                command_retrieve.update_mapping(appm);
+                // Packages usually install icons along with desktop files.
+                command_retrieve.update_icons();
+                command_retrieve.prepare_standby();
+            }
+            if (appm.get_limit_exceeded_count() != limit_exceeded_count) {
+                limit_exceeded_count = appm.get_limit_exceeded_count();
+                SPDLOG_WARN("{} desktop files have been skipped because they "
+                            "exceed parsing limits (since startup).",
+                            limit_exceeded_count);
+            }
+        };
+
+    // Execute the app in a separate process unless i3 mode is in use.
+    auto execute =
+        [&](const RunPhase::CommandRetrievalLoop::CommandInfoVariant &info) {
+            if (is_i3) {
+                executor->execute(info);
+                return;
+            }
+            pid_t pid = fork();
+            switch (pid) {
+            case -1:
+                perror("fork");
+                exit(EXIT_FAILURE);
+            case 0:
+                close(fd);
+                setsid();
+                // This function can throw. It means that the child process can
+                // jump out to main.
+                executor->execute(info);
+                abort();
+            }
+            processes_to_wait_for.push_back(pid);
+        };
+
+    RunPhase::OpenRequestResolver open_resolver;
+
+    command_retrieve.prepare_standby();
+
+    while (1) {
+        watch[0].revents = watch[1].revents = watch[2].revents = 0;
+        // Watches are registered only when there is nothing else to do.
+        int timeout = notify.has_pending_watches() ? 0 : -1;
+        int ret;
+        while ((ret = poll(watch, nfds, timeout)) == -1 && errno == EINTR)
+            ;
+        if (ret == -1)
+            PFATALE("poll");
+        if (ret == 0) {
+            handle_changes(notify.register_pending_watches());
+            continue;
         }
+        if (watch[1].revents & POLLIN)
+            handle_changes(notify.getchanges());
         if (watch[0].revents & POLLIN) {
             // It can happen that the user tries to execute j4dd several times
             // but has forgot to start j4dd. They then run it in wait on mode
             // and then j4dd would be invoked several times because the FIFO has
             // a bunch of events piled up. This nonblocking read() loop prevents
-            // this.
-            char data;
-            ssize_t err = read(fd, &data, sizeof(data));
-            bool nothing_received = false;
-            if (err > 0) {
-                while ((err = read(fd, &data, sizeof(data))) == 1)
-                    continue;
-            } else if (err == 0)
-                nothing_received = true;
+            // this. Everything is read, launch requests are interleaved with
+            // command bytes (see LaunchRequest.hh).
+            std::string data;
+            char buf[PIPE_BUF];
+            ssize_t err;
+            while ((err = read(fd, buf, sizeof buf)) > 0)
+                data.append(buf, err);
             if (err == -1 && errno != EAGAIN)
                 PFATALE("read");
             if (err == 0) {
@@ -963,37 +1404,74 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
                     PFATALE("open");
                 watch[0].fd = fd;
                 watch[0].revents = 0;
-                if (nothing_received)
+                if (data.empty())
                     continue;
             }
+
+            LaunchRequest::FifoInput input = LaunchRequest::parse(data);
+            // Requests are executed in order, before dmenu is shown. Only
+            // launch requests modify history.
+            bool history_changed = false;
+            for (LaunchRequest::Request &request : input.requests) {
+                if (request.type == LaunchRequest::Type::open) {
+                    for (const std::string &target : request.args) {
+                        auto command_info =
+                            open_resolver.resolve(appm, target);
+                        if (command_info)
+                            execute(*command_info);
+                    }
+                    continue;
+                }
+                auto command_info =
+                    command_retrieve.launch_by_ID(appm, std::move(request));
+                if (command_info) {
+                    execute(*command_info);
+                    history_changed = true;
+                }
+            }
+            if (!input.command) {
+                if (history_changed)
+                    command_retrieve.prepare_standby();
+                continue;
+            }
+
             // Only the last event is taken into account (there is usually only
             // a single event).
-            if (data == 'q')
+            char command = *input.command;
+            if (command == 'q')
                 exit(EXIT_SUCCESS);
+            if (command == 'r') {
+                // Re-execute j4dd. This is useful when j4dd has been upgraded.
+                // The state is handed off to the new process to avoid reading
+                // all desktop files again. History isn't part of the state,
+                // it is read from the history file.
+                SPDLOG_INFO("Re-executing j4-dmenu-desktop...");
+                command_retrieve.discard_standby();
+                StateWriter state;
+                state.write_string(state_fingerprint);
+                appm.save_state(state);
+                bool notify_saved = notify.save_state(state);
+                state.write_int(processes_to_wait_for.size());
+                for (pid_t pid : processes_to_wait_for)
+                    state.write_int(pid);
+                StateHandoff::reexec(argv, notify_saved ? &state : nullptr);
+                // reexec() has failed, continue normally.
+                command_retrieve.prepare_standby();
+                continue;
+            }
 
+            if (history_changed) {
+                // The standby dmenu contains the menu from before the history
+                // has been updated.
+                command_retrieve.discard_standby();
+            }
             command_retrieve.run_dmenu();
 
             auto user_response = command_retrieve.prompt_user_for_choice();
-            if (user_response) {
-                if (is_i3)
-                    executor->execute(*user_response);
-                else {
-                    pid_t pid = fork();
-                    switch (pid) {
-                    case -1:
-                        perror("fork");
-                        exit(EXIT_FAILURE);
-                    case 0:
-                        close(fd);
-                        setsid();
-                        // This function can throw. It means that the child
-                        // process can jump out to main.
-                        executor->execute(*user_response);
-                        abort();
-                    }
-                    processes_to_wait_for.push_back(pid);
-                }
-            }
+            if (user_response)
+                execute(*user_response);
+            // Get ready for the next invocation.
+            command_retrieve.prepare_standby();
         }
         if (watch[0].revents & POLLHUP) {
             // The writing client has closed. We won't be able to poll()
@@ -1044,6 +1522,172 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
     abort();
 }
 
+// This is the client side of --launch and --open. The request is sent to a
+// running j4dd daemon, which does all the work.
+[[noreturn]] static void
+send_launch_request(const char *wait_on, const LaunchRequest::Request &req) {
+    std::string data;
+    try {
+        data = LaunchRequest::encode(req);
+    } catch (const std::invalid_argument &e) {
+        SPDLOG_ERROR("Invalid request: {}", e.what());
+        exit(EXIT_FAILURE);
+    }
+
+    // O_NONBLOCK makes open() fail instead of blocking when the daemon isn't
+    // running.
+    int fd = open(wait_on, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENXIO || errno == ENOENT)
+            SPDLOG_ERROR("j4-dmenu-desktop isn't running with --wait-on={}!",
+                         wait_on);
+        else
+            SPDLOG_ERROR("Couldn't open '{}': {}", wait_on, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    // The request is smaller than PIPE_BUF, so it is written atomically. It
+    // can't be written only partially.
+    if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+        SPDLOG_ERROR("Couldn't send request to '{}': {}", wait_on,
+                     strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    exit(EXIT_SUCCESS);
+}
+
+// Launch all enabled autostart entries (see --autostart). NormalExecutable
+// replaces the current process, so each entry is executed in a child process.
+// Children are spawned concurrently, but the number of children which haven't
+// executed their app yet is bounded. Spawn latency (the time between fork()
+// and a successful execve()) is reported for every entry. Other executors
+// don't execute anything in the current process, entries are handled one by
+// one then.
+[[noreturn]] static void do_autostart(const AppManager &appm,
+                                      ExecutePhase::BaseExecutable *executor) {
+    using clock = std::chrono::steady_clock;
+    using CommandInfoVariant =
+        RunPhase::CommandRetrievalLoop::CommandInfoVariant;
+    using DesktopCommandInfo =
+        RunPhase::CommandRetrievalLoop::DesktopCommandInfo;
+
+    stringlist_t IDs = appm.list_IDs();
+    size_t started = 0;
+
+    auto get_command_info = [&appm](const std::string &ID) {
+        return CommandInfoVariant(std::in_place_type_t<DesktopCommandInfo>{},
+                                  &appm.lookup_by_ID(ID)->get(),
+                                  stringlist_t{});
+    };
+    auto report = [&started](const std::string &ID, clock::time_point start,
+                             bool success) {
+        std::chrono::duration<double, std::milli> latency =
+            clock::now() - start;
+        if (success) {
+            ++started;
+            SPDLOG_INFO("Autostart: Started '{}' in {:.2f} ms.", ID,
+                        latency.count());
+        } else
+            SPDLOG_ERROR("Autostart: Couldn't start '{}'!", ID);
+    };
+
+    clock::time_point autostart_start = clock::now();
+
+    if (dynamic_cast<ExecutePhase::NormalExecutable *>(executor) == nullptr) {
+        for (const std::string &ID : IDs) {
+            clock::time_point start = clock::now();
+            try {
+                executor->execute(get_command_info(ID));
+                report(ID, start, true);
+            } catch (const std::runtime_error &e) {
+                SPDLOG_ERROR("{}", e.what());
+                report(ID, start, false);
+            }
+        }
+    } else {
+        struct Spawn
+        {
+            std::string ID;
+            pid_t pid;
+            int fd; // read end of the pipe, see spawn_error_fd
+            clock::time_point start;
+        };
+
+        const size_t max_pending =
+            std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+        std::vector<Spawn> pending;
+        std::vector<pollfd> watch;
+        auto next = IDs.cbegin();
+
+        while (next != IDs.cend() || !pending.empty()) {
+            for (; next != IDs.cend() && pending.size() < max_pending; ++next) {
+                int pipefd[2];
+                if (pipe2(pipefd, O_CLOEXEC) == -1)
+                    PFATALE("pipe2");
+                clock::time_point start = clock::now();
+                pid_t pid = fork();
+                switch (pid) {
+                case -1:
+                    PFATALE("fork");
+                case 0:
+                    close(pipefd[0]);
+                    setsid();
+                    ExecutePhase::spawn_error_fd = pipefd[1];
+                    try {
+                        executor->execute(get_command_info(*next));
+                    } catch (const std::runtime_error &e) {
+                        SPDLOG_ERROR("{}", e.what());
+                    }
+                    ExecutePhase::report_spawn_failure();
+                    _exit(EXIT_FAILURE);
+                }
+                close(pipefd[1]);
+                pending.push_back({*next, pid, pipefd[0], start});
+            }
+
+            watch.clear();
+            for (const Spawn &spawn : pending)
+                watch.push_back({spawn.fd, POLLIN, 0});
+            while (poll(watch.data(), watch.size(), -1) == -1) {
+                if (errno != EINTR)
+                    PFATALE("poll");
+            }
+
+            // Iterate backwards to be able to erase finished spawns.
+            for (size_t i = pending.size(); i-- > 0;) {
+                if (watch[i].revents == 0)
+                    continue;
+                Spawn &spawn = pending[i];
+                char failure;
+                ssize_t ret;
+                while ((ret = read(spawn.fd, &failure, 1)) == -1 &&
+                       errno == EINTR)
+                    ;
+                if (ret == -1)
+                    PFATALE("read");
+                close(spawn.fd);
+                // EOF means that the pipe has been closed by execve().
+                bool success = ret == 0;
+                // The child exits right after reporting a failure.
+                if (!success && waitpid(spawn.pid, NULL, 0) == -1)
+                    PFATALE("waitpid");
+                report(spawn.ID, spawn.start, success);
+                pending.erase(pending.begin() + i);
+            }
+        }
+    }
+
+    std::chrono::duration<double, std::milli> total =
+        clock::now() - autostart_start;
+    // See the "Read {} .desktop files" message in main() for the reason why
+    // this is printed twice.
+    fmt::print(stderr, "Started {} of {} autostart entries in {:.2f} ms.\n",
+               started, IDs.size(), total.count());
+    SPDLOG_INFO("Started {} of {} autostart entries in {:.2f} ms.", started,
+                IDs.size(), total.count());
+    exit(started == IDs.size() ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 // clang-format off
 /*
  * ORDER OF OPERATION:
@@ -1051,6 +1695,8 @@ do_wait_on(NotifyBase &notify, const char *wait_on, AppManager &appm,
  * 2) start dmenu if not in wait_on mode
  *    It's good to start it early, because the user could have specified the
  *    -f flag to dmenu
+ *    If --menu-cache is enabled and the cached menu is usable, it is shown
+ *    right away. The following steps then run while the user is choosing.
  * 3) collect absolute pathnames of all desktop files
  * 4) construct AppManager (which will load these in)
  * 5) initialize history
@@ -1097,6 +1743,9 @@ int main(int argc, char **argv) {
     std::string terminal;
     std::string wrapper;
     const char *wait_on = nullptr;
+    const char *launch_id = nullptr;
+    bool open_targets = false;
+    bool autostart = false;
 
     bool use_xdg_de = false;
     bool exclude_generic = false;
@@ -1107,7 +1756,12 @@ int main(int argc, char **argv) {
     bool use_i3_ipc = false;
     bool skip_i3_check = false;
     bool prune_bad_usage_log_entries = false;
+    bool use_icons = false;
+    std::string icon_theme = "hicolor";
+    int icon_size = 48;
+    bool use_menu_cache = false;
     ParsingQuirks quirks{true, true};
+    ParsingLimits limits;
 
     // This variable doesn't have much use, wine_compatibility_mode is more
     // important. It is only used to detect if both mutaly exclusive flags have
@@ -1138,6 +1792,9 @@ int main(int argc, char **argv) {
             {"usage-log",                   required_argument, 0, 'l'},
             {"prune-bad-usage-log-entries", no_argument,       0, 'p'},
             {"wait-on",                     required_argument, 0, 'w'},
+            {"launch",                      required_argument, 0, 'A'},
+            {"open",                        no_argument,       0, 'G'},
+            {"autostart",                   no_argument,       0, 'a'},
             {"no-exec",                     no_argument,       0, 'e'},
             {"wrapper",                     required_argument, 0, 'W'},
             {"case-insensitive",            no_argument,       0, 'i'},
@@ -1149,6 +1806,11 @@ int main(int argc, char **argv) {
             {"desktop-file-quirks",         required_argument, 0, 'D'},
             {"strict-parsing",              no_argument,       0, 'R'},
             {"version",                     no_argument,       0, 'E'},
+            {"icons",                       no_argument,       0, 'c'},
+            {"icon-theme",                  required_argument, 0, 'C'},
+            {"icon-size",                   required_argument, 0, 'z'},
+            {"menu-cache",                  no_argument,       0, 'm'},
+            {"parsing-limits",              required_argument, 0, 'L'},
             {0,                             0,                 0, 0  }
         };
 
@@ -1211,6 +1873,15 @@ int main(int argc, char **argv) {
         case 'w':
             wait_on = optarg;
             break;
+        case 'A':
+            launch_id = optarg;
+            break;
+        case 'G':
+            open_targets = true;
+            break;
+        case 'a':
+            autostart = true;
+            break;
         case 'e':
             no_exec = true;
             break;
@@ -1301,12 +1972,81 @@ int main(int argc, char **argv) {
         case 'E':
             puts(version());
             exit(EXIT_SUCCESS);
+        case 'c':
+            use_icons = true;
+            break;
+        case 'C':
+            icon_theme = optarg;
+            if (icon_theme.empty() ||
+                icon_theme.find('/') != std::string::npos) {
+                fmt::print(stderr,
+                           "Invalid icon theme supplied to --icon-theme!\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'z': {
+            char *endptr;
+            long size = strtol(optarg, &endptr, 10);
+            if (*optarg == '\0' || *endptr != '\0' || size <= 0 ||
+                size > 4096) {
+                fmt::print(stderr, "Invalid icon size supplied to "
+                                   "--icon-size!\n");
+                exit(EXIT_FAILURE);
+            }
+            icon_size = size;
+            break;
+        }
+        case 'm':
+            use_menu_cache = true;
+            break;
+        case 'L':
+            arg = optarg;
+            if (arg == "none") {
+                limits.disable();
+                break;
+            }
+            for (const auto &curr_arg : split((std::string)arg, ',')) {
+                auto equals = curr_arg.find('=');
+                if (equals == std::string::npos) {
+                    fmt::print(stderr, "Invalid limit '{}' supplied to "
+                                       "--parsing-limits!\n",
+                               curr_arg);
+                    exit(EXIT_FAILURE);
+                }
+                std::string name = curr_arg.substr(0, equals);
+                const char *value = curr_arg.c_str() + equals + 1;
+                char *endptr;
+                errno = 0;
+                unsigned long long number = strtoull(value, &endptr, 10);
+                if (*value == '\0' || *value == '-' || *endptr != '\0' ||
+                    errno != 0) {
+                    fmt::print(stderr, "Invalid limit '{}' supplied to "
+                                       "--parsing-limits!\n",
+                               curr_arg);
+                    exit(EXIT_FAILURE);
+                }
+                if (name == "size")
+                    limits.max_file_size = number;
+                else if (name == "line")
+                    limits.max_line_length = number;
+                else if (name == "keys")
+                    limits.max_keys_per_group = number;
+                else if (name == "time")
+                    limits.parse_time_budget = number;
+                else {
+                    fmt::print(stderr, "Unknown limit '{}' supplied to "
+                                       "--parsing-limits!\n",
+                               name);
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
         default:
             exit(1);
         }
     }
 
-    if (optind != argc) {
+    if (optind != argc && !launch_id && !open_targets) {
         SPDLOG_WARN("Positional arguments '{}' are unused!",
                     fmt::join(argv + optind, argv + argc, " "));
     }
@@ -1353,6 +2093,54 @@ int main(int argc, char **argv) {
     // alignment to the line number part of the message.
     spdlog::set_pattern("[%Y-%m-%d %T.%e] [%^%l%$] [%s:%-3#] %v");
 
+    /// Send a launch or open request to the daemon
+    if (launch_id && open_targets) {
+        SPDLOG_ERROR("You can't use both --launch and --open!");
+        exit(EXIT_FAILURE);
+    }
+    if (launch_id) {
+        if (!wait_on) {
+            SPDLOG_ERROR("--launch requires --wait-on!");
+            exit(EXIT_FAILURE);
+        }
+        // Positional arguments are passed to the app.
+        stringlist_t args(argv + optind, argv + argc);
+        send_launch_request(wait_on, LaunchRequest::Request(launch_id, args));
+    }
+    if (open_targets) {
+        if (!wait_on) {
+            SPDLOG_ERROR("--open requires --wait-on!");
+            exit(EXIT_FAILURE);
+        }
+        if (optind == argc) {
+            SPDLOG_ERROR("--open requires at least one file or URL!");
+            exit(EXIT_FAILURE);
+        }
+        // The daemon has a different working directory. Relative paths must
+        // be made absolute. Existing files take precedence over URLs to allow
+        // opening files with colons in their names.
+        std::string cwd;
+        stringlist_t targets;
+        for (int i = optind; i < argc; ++i) {
+            std::string target = argv[i];
+            if (!target.empty() && target.front() != '/' &&
+                (access(argv[i], F_OK) == 0 ||
+                 get_url_scheme(target).empty())) {
+                if (cwd.empty()) {
+                    char *dir = getcwd(nullptr, 0);
+                    if (!dir)
+                        PFATALE("getcwd");
+                    cwd = dir;
+                    free(dir);
+                }
+                target = cwd + '/' + target;
+            }
+            targets.push_back(std::move(target));
+        }
+        send_launch_request(wait_on,
+                            LaunchRequest::Request(std::move(targets)));
+    }
+
     /// i3 ipc
     SPDLOG_DEBUG("I3 IPC interface is {}.", (use_i3_ipc ? "on" : "off"));
 
@@ -1390,6 +2178,16 @@ int main(int argc, char **argv) {
         SPDLOG_WARN("I3 and noexec mode have been specified. I3 mode will be "
                     "ignored.");
 
+    if (autostart) {
+        if (wait_on) {
+            SPDLOG_ERROR("You can't use both --autostart and --wait-on!");
+            exit(EXIT_FAILURE);
+        }
+        // The Desktop Application Autostart Specification requires
+        // OnlyShowIn/NotShowIn to be honored.
+        use_xdg_de = true;
+    }
+
     /// Get desktop envs for OnlyShowIn/NotShowIn if enabled
     stringlist_t desktopenvs;
     if (use_xdg_de) {
@@ -1429,12 +2227,37 @@ int main(int argc, char **argv) {
             terminal = "gnome-terminal";
     }
 
+    /// Launch autostart entries
+    if (autostart) {
+        stringlist_t autostart_path = get_autostart_search_path();
+        SPDLOG_INFO("Found {} autostart directories:", autostart_path.size());
+        for (const std::string &path : autostart_path)
+            SPDLOG_INFO(" {}", path);
+
+        AppManager appm(SetupPhase::collect_autostart_files(autostart_path),
+                        desktopenvs, LocaleSuffixes::from_environment(),
+                        quirks, limits, DesktopFileUse::autostart);
+        auto executor = ExecutePhase::create_executor(
+            no_exec, use_i3_ipc, std::move(terminal), std::move(wrapper),
+            i3_ipc_path, term_mode, quirks);
+        do_autostart(appm, executor.get());
+    }
+
     /// Start dmenu early
     Dmenu dmenu(dmenu_command, shell);
 
     if (!wait_on)
         dmenu.run();
 
+    /// Take state inherited from the previous instance of j4dd
+    std::optional<StateReader> inherited_state =
+        StateHandoff::take_inherited_state();
+    if (inherited_state && !wait_on) {
+        SPDLOG_WARN("Inherited state is usable only in --wait-on mode.");
+        inherited_state->close_fds();
+        inherited_state.reset();
+    }
+
     /// Get search path
     stringlist_t search_path = get_search_path();
 
@@ -1445,14 +2268,28 @@ int main(int argc, char **argv) {
 
     SetupPhase::validate_search_path(search_path);
 
-    /// Collect desktop files
-    auto desktop_file_list = SetupPhase::collect_files(search_path);
-    SPDLOG_DEBUG("The following desktop files have been found:");
-    for (const auto &item : desktop_file_list) {
-        SPDLOG_DEBUG(" {}", item.base_path);
-        for (const std::string &file : item.files)
-            SPDLOG_DEBUG("   {}", file);
+    /// Show cached menu
+    std::optional<MenuCache> menu_cache;
+    std::optional<std::string> speculative_menu;
+    if (use_menu_cache) {
+        std::string cache_path = get_cache_dir();
+        if (wait_on)
+            SPDLOG_WARN("--menu-cache is ignored in --wait-on mode.");
+        else if (!cache_path.empty()) {
+            std::string key =
+                SetupPhase::get_menu_cache_key(argc, argv, search_path);
+            cache_path += fmt::format("menu-{:016x}",
+                                      std::hash<std::string>{}(key));
+            menu_cache.emplace(std::move(cache_path), std::move(key));
+            speculative_menu = menu_cache->load();
+            if (speculative_menu) {
+                SPDLOG_INFO("Showing cached menu, desktop files will be read "
+                            "in the meantime.");
+                RunPhase::show_menu(dmenu, *speculative_menu);
+            }
+        }
     }
+
     LocaleSuffixes locales = LocaleSuffixes::from_environment();
     {
         auto suffixes = locales.list_suffixes_for_logging_only();
@@ -1460,30 +2297,108 @@ int main(int argc, char **argv) {
         for (const auto &ptr : suffixes)
             SPDLOG_DEBUG(" {}", *ptr);
     }
-    /// Construct AppManager
-    AppManager appm(desktop_file_list, desktopenvs, std::move(locales), quirks);
+
+    std::string state_fingerprint =
+        SetupPhase::get_state_fingerprint(search_path, desktopenvs, quirks,
+                                          limits);
+
+    // AppManager can't be moved, it has to be wrapped in an optional to be
+    // constructed conditionally.
+    std::optional<AppManager> appm_storage;
+    std::unique_ptr<NotifyBase> notify;
+    std::vector<pid_t> processes_to_wait_for;
+
+    /// Restore AppManager from inherited state
+    if (inherited_state) {
+        try {
+            if (inherited_state->read_string() != state_fingerprint)
+                throw state_error("Search path, desktop environments, "
+                                  "parsing quirks or parsing limits have "
+                                  "changed.");
+            appm_storage.emplace(*inherited_state, desktopenvs, locales,
+                                 limits);
+#ifdef USE_KQUEUE
+            // NotifyKqueue doesn't save its state, this shouldn't happen.
+            throw state_error("kqueue doesn't support state handoff.");
+#else
+            notify = std::make_unique<NotifyInotify>(*inherited_state);
+#endif
+            int64_t process_count = inherited_state->read_int();
+            for (int64_t i = 0; i < process_count; ++i) {
+                int64_t pid = inherited_state->read_int();
+                if (pid <= 0)
+                    throw state_error("Invalid PID.");
+                processes_to_wait_for.push_back(pid);
+            }
+            fmt::print(stderr, "Restored {} apps from inherited state.\n",
+                       appm_storage->count());
+            SPDLOG_INFO("Restored {} apps from inherited state.",
+                        appm_storage->count());
+        } catch (const state_error &e) {
+            SPDLOG_WARN("Couldn't restore inherited state, desktop files will "
+                        "be read normally: {}",
+                        e.what());
+            appm_storage.reset();
+            notify.reset();
+            processes_to_wait_for.clear();
+        }
+        inherited_state->close_fds();
+        inherited_state.reset();
+    }
+
+    // These are used to set up NotifyInotify (see do_wait_on()).
+    std::vector<stringlist_t> known_files;
+    time_t scan_start = 0;
+
+    if (!appm_storage) {
+        /// Collect desktop files
+        scan_start = time(NULL);
+        auto desktop_file_list = SetupPhase::collect_files(
+            search_path, (menu_cache ? &*menu_cache : nullptr));
+        SPDLOG_DEBUG("The following desktop files have been found:");
+        for (const auto &item : desktop_file_list) {
+            SPDLOG_DEBUG(" {}", item.base_path);
+            for (const std::string &file : item.files)
+                SPDLOG_DEBUG("   {}", file);
+        }
+
+        if (wait_on) {
+            for (const auto &item : desktop_file_list)
+                known_files.push_back(item.files);
+        }
+
+        /// Construct AppManager
+        appm_storage.emplace(desktop_file_list, desktopenvs, std::move(locales),
+                             quirks, limits);
+
+        // The following message is printed twice. Once directly and once as a
+        // log. The log won't be shown (unless the user has set higher logging
+        // verbosity).
+        // It is printed twice because it should be shown, but it doesn't
+        // qualify for the ERROR log level (which is shown by default) and
+        // because the message was printed as is before logging was introduced
+        // to j4dd. If only a log was printed, it would a) not be printed if
+        // user doesn't specify -v which is bad b) have to be misclassified as
+        // ERROR c) logging info (timestamp, thread name, file + line number...)
+        // would be added, which adds unnecessary clutter.
+        int desktop_file_count =
+            SetupPhase::count_collected_desktop_files(desktop_file_list);
+        fmt::print(stderr, "Read {} .desktop files, found {} apps.\n",
+                   desktop_file_count, appm_storage->count());
+        SPDLOG_INFO("Read {} .desktop files, found {} apps.",
+                    desktop_file_count, appm_storage->count());
+        if (appm_storage->get_limit_exceeded_count() != 0)
+            SPDLOG_WARN("{} desktop files have been skipped because they "
+                        "exceed parsing limits.",
+                        appm_storage->get_limit_exceeded_count());
+    }
+
+    AppManager &appm = *appm_storage;
 
 #ifdef DEBUG
     appm.check_inner_state();
 #endif
 
-    // The following message is printed twice. Once directly and once as a
-    // log. The log won't be shown (unless the user has set higher logging
-    // verbosity).
-    // It is printed twice because it should be shown, but it doesn't
-    // qualify for the ERROR log level (which is shown by default) and
-    // because the message was printed as is before logging was introduced
-    // to j4dd. If only a log was printed, it would a) not be printed if
-    // user doesn't specify -v which is bad b) have to be misclassified as
-    // ERROR c) logging info (timestamp, thread name, file + line number...)
-    // would be added, which adds unnecessary clutter.
-    int desktop_file_count =
-        SetupPhase::count_collected_desktop_files(desktop_file_list);
-    fmt::print(stderr, "Read {} .desktop files, found {} apps.\n",
-               desktop_file_count, appm.count());
-    SPDLOG_INFO("Read {} .desktop files, found {} apps.", desktop_file_count,
-                appm.count());
-
     /// Format names
     SetupPhase::NameToAppMapping mapping(appformatter, case_insensitive,
                                          exclude_generic);
@@ -1505,31 +2420,43 @@ int main(int argc, char **argv) {
         }
     }
 
+    /// Initialize icon lookup
+    std::optional<IconLookup> icons;
+    if (use_icons) {
+        std::string cache_path = get_cache_dir();
+        if (!cache_path.empty())
+            cache_path +=
+                "icons-" + icon_theme + '-' + std::to_string(icon_size);
+        icons.emplace(icon_theme, icon_size, IconLookup::get_base_dirs(),
+                      cache_path);
+    }
+
     RunPhase::CommandRetrievalLoop command_retrieval_loop(
-        std::move(dmenu), std::move(mapping), std::move(hist_manager), no_exec);
+        std::move(dmenu), std::move(mapping), std::move(hist_manager),
+        std::move(icons), no_exec, std::move(menu_cache),
+        std::move(speculative_menu));
 
     using namespace ExecutePhase;
 
-    std::unique_ptr<BaseExecutable> executor;
-    if (no_exec)
-        executor = std::make_unique<FakeExecutable>(
-            std::move(terminal), std::move(wrapper), term_mode, quirks);
-    else if (use_i3_ipc)
-        executor = std::make_unique<I3Executable>(
-            std::move(terminal), i3_ipc_path, term_mode, quirks);
-    else
-        executor = std::make_unique<NormalExecutable>(
-            std::move(terminal), std::move(wrapper), term_mode, quirks);
+    std::unique_ptr<BaseExecutable> executor =
+        create_executor(no_exec, use_i3_ipc, std::move(terminal),
+                        std::move(wrapper), i3_ipc_path, term_mode, quirks);
 
     try {
         if (wait_on) {
+            if (!notify) {
 #ifdef USE_KQUEUE
-            NotifyKqueue notify(search_path);
+                notify = std::make_unique<NotifyKqueue>(search_path);
 #else
-            NotifyInotify notify(search_path);
+                // Directories are watched after the daemon becomes ready.
+                notify = std::make_unique<NotifyInotify>(
+                    search_path, known_files, scan_start);
+                known_files.clear();
 #endif
-            do_wait_on(notify, wait_on, appm, search_path,
-                       command_retrieval_loop, executor.get());
+            }
+            do_wait_on(*notify, wait_on, appm, search_path,
+                       command_retrieval_loop, executor.get(), argv,
+                       state_fingerprint, std::move(processes_to_wait_for));
             abort();
         } else {
             std::optional<RunPhase::CommandRetrievalLoop::CommandInfoVariant>
@@ -106,7 +106,7 @@ static void rmdir_impl(const std::string &path) {
         enum class file_type { file, directory } ft;
         switch (dirinfo->d_type) {
         case DT_DIR:
-            ft = file_type::file;
+            ft = file_type::directory;
             break;
         case DT_UNKNOWN:
             struct stat info;
@@ -122,7 +122,7 @@ static void rmdir_impl(const std::string &path) {
 
         switch (ft) {
         case file_type::directory:
-            rmdir_recursive(subpath.c_str());
+            rmdir_impl(subpath);
             if (rmdir(subpath.c_str()) == -1)
                 throw std::runtime_error("Error while calling rmdir() on '" +
                                          subpath + "': " + strerror(errno));
@@ -153,6 +153,67 @@ void rmdir_recursive(const char *dirname) {
                                  dirname + "': " + strerror(errno));
 }
 
+static void copy_directory_impl(const std::string &source,
+                                const std::string &destination) {
+    DIR *d = opendir(source.c_str());
+    if (d == NULL)
+        throw std::runtime_error("Error while calling opendir() on '" +
+                                 source + "': " + strerror(errno));
+
+    OnExit closed = [d]() { closedir(d); };
+
+    dirent *dirinfo;
+    errno = 0;
+    while ((dirinfo = readdir(d)) != NULL) {
+        if (strcmp(dirinfo->d_name, ".") == 0 ||
+            strcmp(dirinfo->d_name, "..") == 0)
+            continue;
+
+        string subpath = source + '/' + dirinfo->d_name;
+        string destpath = destination + '/' + dirinfo->d_name;
+
+        struct stat info;
+        if (stat(subpath.c_str(), &info) == -1)
+            throw std::runtime_error("Error while calling stat() on '" +
+                                     subpath + "': " + strerror(errno));
+
+        if (S_ISDIR(info.st_mode)) {
+            if (mkdir(destpath.c_str(), 0700) == -1)
+                throw std::runtime_error("Error while calling mkdir() on '" +
+                                         destpath + "': " + strerror(errno));
+            copy_directory_impl(subpath, destpath);
+        } else if (S_ISREG(info.st_mode)) {
+            int in = open(subpath.c_str(), O_RDONLY | O_CLOEXEC);
+            if (in == -1)
+                throw std::runtime_error("Error while calling open() on '" +
+                                         subpath + "': " + strerror(errno));
+            OnExit close_in = [in]() { close(in); };
+            int out = open(destpath.c_str(),
+                           O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+            if (out == -1)
+                throw std::runtime_error("Error while calling open() on '" +
+                                         destpath + "': " + strerror(errno));
+            OnExit close_out = [out]() { close(out); };
+            copy_file_fd(in, out);
+        }
+
+        errno = 0;
+    }
+    if (errno != 0)
+        throw std::runtime_error("Error while calling readdir() on '" +
+                                 source + "': " + strerror(errno));
+}
+
+void copy_directory_recursive(const char *source, const char *destination) {
+    try {
+        copy_directory_impl(source, destination);
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error((string) "Error while copying directory '" +
+                                 source + "' to '" + destination +
+                                 "': " + e.what());
+    }
+}
+
 TempFile::TempFile(string_view name_prefix)
     : name("/tmp/" + string(name_prefix) + "-XXXXXX") {
     int fd = mkstemp(this->name.data());
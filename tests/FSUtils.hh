@@ -31,6 +31,9 @@ using std::string_view;
 void copy_file_fd(int in, int out);
 bool compare_files_fd(int afd, int bfd, const char *a, const char *b);
 void rmdir_recursive(const char *dirname);
+// Copy the contents of directory source to directory destination (which must
+// exist). Only regular files and directories are copied.
+void copy_directory_recursive(const char *source, const char *destination);
 
 class TempFile
 {
@@ -24,6 +24,7 @@
 #include <fcntl.h>
 #include <functional>
 #include <optional>
+#include <random>
 #include <stdexcept>
 #include <stdio.h>
 #include <string.h>
@@ -716,6 +717,118 @@ TEST_CASE("Test lookup by ID", "[AppManager]") {
 
     REQUIRE(apps.lookup_by_ID("chromium.desktop").value().get().name ==
             "Chromium");
+    // NoDisplay apps can be looked up, they are only hidden from the menu.
+    REQUIRE(apps.lookup_by_ID("hidden.desktop").value().get().no_display);
+    REQUIRE_FALSE(apps.lookup_by_ID("unknown.desktop"));
+    REQUIRE(apps.list_IDs() == stringlist_t{"chromium.desktop",
+                                            "firefox.desktop",
+                                            "hidden.desktop"});
+}
+
+TEST_CASE("Test NoDisplay desktop files", "[AppManager]") {
+    char tmpdirname[] = "/tmp/j4dd-appmanager-nodisplay-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+
+    std::string high = (std::string)tmpdirname + "/high/";
+    std::string low = (std::string)tmpdirname + "/low/";
+    if (mkdir(high.c_str(), 0700) == -1 || mkdir(low.c_str(), 0700) == -1)
+        SKIP("mkdir: " << strerror(errno));
+
+    auto write_file = [](const std::string &path, const char *extra) {
+        FILE *f = fopen(path.c_str(), "w");
+        if (f == NULL)
+            SKIP("Couldn't create '" << path << "': " << strerror(errno));
+        fprintf(f,
+                "[Desktop Entry]\nType=Application\nName=Tool\n"
+                "GenericName=Handler\nExec=tool %%f\n"
+                "MimeType=text/x-tool;\n%s",
+                extra);
+        fclose(f);
+    };
+    write_file(high + "tool.desktop", "NoDisplay=true\n");
+    write_file(low + "tool.desktop", "Exec=low-tool\n");
+
+    AppManager apps(
+        {
+            {high, {high + "tool.desktop"}},
+            {low,  {low + "tool.desktop"} },
+    },
+        {}, LocaleSuffixes("en_US"));
+    apps.check_inner_state();
+
+    // The NoDisplay app shadows the lower ranked one, it doesn't provide any
+    // names, but it is still usable.
+    REQUIRE(apps.view_name_app_mapping().empty());
+    auto app = apps.lookup_by_ID("tool.desktop");
+    REQUIRE(app);
+    REQUIRE(app->get().no_display);
+    REQUIRE(app->get().exec == "tool %f");
+    REQUIRE(apps.lookup_by_mime_type("text/x-tool") ==
+            stringlist_t{"tool.desktop"});
+
+    apps.remove(high + "tool.desktop", high);
+    apps.check_inner_state();
+    REQUIRE_FALSE(apps.lookup_by_ID("tool.desktop"));
+    REQUIRE(apps.lookup_by_mime_type("text/x-tool").empty());
+
+    apps.add(low + "tool.desktop", low, 1);
+    apps.check_inner_state();
+    REQUIRE(checkmap(apps, {
+                               {"Tool",    "low-tool"},
+                               {"Handler", "low-tool"},
+    }));
+
+    // Overriding a visible app with a NoDisplay one removes its names.
+    apps.add(high + "tool.desktop", high, 0);
+    apps.check_inner_state();
+    REQUIRE(apps.view_name_app_mapping().empty());
+    REQUIRE(apps.lookup_by_ID("tool.desktop")->get().no_display);
+    REQUIRE(apps.lookup_by_mime_type("text/x-tool") ==
+            stringlist_t{"tool.desktop"});
+
+    // NoDisplay=false is the default.
+    write_file(high + "tool.desktop", "NoDisplay=false\n");
+    apps.add(high + "tool.desktop", high, 0);
+    apps.check_inner_state();
+    REQUIRE(checkmap(apps, {
+                               {"Tool",    "tool %f"},
+                               {"Handler", "tool %f"},
+    }));
+}
+
+TEST_CASE("Test lookup by MIME type", "[AppManager]") {
+    AppManager apps(
+        {
+            {TEST_FILES "mime/applications/",
+             {TEST_FILES "mime/applications/viewer.desktop",
+              TEST_FILES "mime/applications/editor.desktop"}},
+            {TEST_FILES "a/applications/",
+             {TEST_FILES "a/applications/firefox.desktop"}},
+    },
+        {}, LocaleSuffixes("en_US"));
+
+    REQUIRE(apps.lookup_by_mime_type("image/png") ==
+            stringlist_t{"editor.desktop", "viewer.desktop"});
+    REQUIRE(apps.lookup_by_mime_type("application/pdf") ==
+            stringlist_t{"viewer.desktop"});
+    REQUIRE(apps.lookup_by_mime_type("video/mp4").empty());
+
+    apps.remove(TEST_FILES "mime/applications/viewer.desktop",
+                TEST_FILES "mime/applications/");
+    REQUIRE(apps.lookup_by_mime_type("image/png") ==
+            stringlist_t{"editor.desktop"});
+    REQUIRE(apps.lookup_by_mime_type("application/pdf").empty());
+    apps.check_inner_state();
+
+    apps.add(TEST_FILES "mime/applications/viewer.desktop",
+             TEST_FILES "mime/applications/", 0);
+    REQUIRE(apps.lookup_by_mime_type("image/png") ==
+            stringlist_t{"editor.desktop", "viewer.desktop"});
+    apps.check_inner_state();
 }
 
 TEST_CASE("Test NotShowIn/OnlyShowIn", "[AppManager]") {
@@ -1018,3 +1131,162 @@ TEST_CASE("Test removing an unknown desktop file", "[AppManager]") {
     REQUIRE_NOTHROW(apps.remove(TEST_FILES "applications/hidden.desktop",
                                 TEST_FILES "applications/"));
 }
+
+// This test performs a large number of random add() and remove() operations
+// and checks AppManager's inner state after each of them. The resulting
+// name_app_mapping is periodically compared to a simple model of AppManager.
+TEST_CASE("Randomized add/remove stress test", "[AppManager]") {
+    constexpr int rank_count = 2;
+    constexpr int ids_per_rank = 1000;
+    constexpr int name_count = 400;
+    constexpr int operations = 10000;
+
+    char tmpdirname[] = "/tmp/j4dd-appmanager-stress-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+
+    // The seed is fixed to make failures reproducible.
+    std::mt19937 rng(4077);
+    auto random = [&rng](int max) {
+        return std::uniform_int_distribution<int>(0, max - 1)(rng);
+    };
+
+    struct desktop_file
+    {
+        std::string path;
+        std::string name;
+        std::string generic_name;
+        std::string exec;
+        bool hidden;
+        bool no_display;
+    };
+
+    std::vector<std::string> base_paths;
+    std::vector<std::vector<desktop_file>> files(rank_count);
+    for (int rank = 0; rank < rank_count; ++rank) {
+        std::string base = tmpdirname + ("/" + std::to_string(rank) + '/');
+        if (mkdir(base.c_str(), 0700) == -1)
+            SKIP("mkdir: " << strerror(errno));
+        base_paths.push_back(base);
+
+        for (int id = 0; id < ids_per_rank; ++id) {
+            desktop_file file;
+            file.path = base + "app" + std::to_string(id) + ".desktop";
+            file.name = "Name " + std::to_string(random(name_count));
+            switch (random(4)) {
+            case 0:
+                break;
+            case 1:
+                file.generic_name = file.name;
+                break;
+            default:
+                file.generic_name =
+                    "Name " + std::to_string(random(name_count));
+            }
+            file.exec =
+                "app-" + std::to_string(rank) + '-' + std::to_string(id);
+            file.hidden = random(10) == 0;
+            file.no_display = !file.hidden && random(10) == 0;
+
+            std::string contents = "[Desktop Entry]\nType=Application\n"
+                                   "Name=" +
+                                   file.name + "\nExec=" + file.exec + '\n';
+            if (!file.generic_name.empty())
+                contents += "GenericName=" + file.generic_name + '\n';
+            if (file.hidden)
+                contents += "Hidden=true\n";
+            if (file.no_display)
+                contents += "NoDisplay=true\n";
+
+            FILE *f = fopen(file.path.c_str(), "w");
+            if (f == NULL)
+                SKIP("Couldn't create '" << file.path
+                                         << "': " << strerror(errno));
+            fputs(contents.c_str(), f);
+            fclose(f);
+
+            files[rank].push_back(std::move(file));
+        }
+    }
+
+    // AppManager starts empty, all desktop files are added by add().
+    Desktop_file_list initial_files;
+    for (const std::string &base : base_paths)
+        initial_files.emplace_back(base, std::vector<std::string>{});
+    AppManager apps(std::move(initial_files), {}, LocaleSuffixes("en_US"));
+
+    // Model of AppManager's applications. It maps desktop file ID to the
+    // desktop file which occupies it (files[rank][id]).
+    std::unordered_map<int /* id */, int /* rank */> model;
+
+    auto check_model = [&]() {
+        // For each name, collect the lowest rank providing it and all
+        // Execs of desktop files providing it in that rank.
+        using candidates = std::pair<int /* rank */, stringlist_t /* Exec */>;
+        std::unordered_map<std::string, candidates> expected;
+        for (const auto &[id, rank] : model) {
+            const desktop_file &file = files[rank][id];
+            // Only enabled apps can be looked up by their desktop ID.
+            auto app = apps.lookup_by_ID("app" + std::to_string(id) +
+                                         ".desktop");
+            REQUIRE(app.has_value() == !file.hidden);
+            if (file.hidden || file.no_display)
+                continue;
+            for (const std::string *name : {&file.name, &file.generic_name}) {
+                if (name->empty())
+                    continue;
+                auto [iter, inserted] = expected.try_emplace(
+                    *name, rank, stringlist_t{file.exec});
+                if (inserted)
+                    continue;
+                auto &[best_rank, execs] = iter->second;
+                if (rank < best_rank) {
+                    best_rank = rank;
+                    execs = {file.exec};
+                } else if (rank == best_rank) {
+                    execs.push_back(file.exec);
+                }
+            }
+        }
+
+        const auto &mapping = apps.view_name_app_mapping();
+        REQUIRE(mapping.size() == expected.size());
+        for (const auto &[name, resolved] : mapping) {
+            auto iter = expected.find((std::string)name);
+            REQUIRE(iter != expected.end());
+            const auto &execs = iter->second.second;
+            INFO("Name '" << name << "' resolves to " << resolved.app->exec);
+            REQUIRE(std::find(execs.begin(), execs.end(),
+                              resolved.app->exec) != execs.end());
+        }
+    };
+
+    for (int i = 0; i < operations; ++i) {
+        int rank = random(rank_count);
+        int id = random(ids_per_rank);
+        const desktop_file &file = files[rank][id];
+
+        if (random(2) == 0) {
+            apps.add(file.path, base_paths[rank], rank);
+            auto iter = model.find(id);
+            if (iter == model.end())
+                model.emplace(id, rank);
+            else if (iter->second >= rank)
+                iter->second = rank;
+        } else {
+            apps.remove(file.path, base_paths[rank]);
+            model.erase(id);
+        }
+
+        apps.check_inner_state();
+
+        if (i % 1000 == 999)
+            check_model();
+    }
+
+    REQUIRE(apps.count() == model.size());
+    check_model();
+}
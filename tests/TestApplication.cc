@@ -15,14 +15,26 @@
 // along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <catch2/catch_message.hpp>
 #include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <errno.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <sys/stat.h>
 
 #include "generated/tests_config.hh"
 
 #include "Application.hh"
+#include "FSUtils.hh"
 #include "LineReader.hh"
 #include "LocaleSuffixes.hh"
+#include "ParsingLimits.hh"
+#include "Utilities.hh"
 
 TEST_CASE("Test nonexistent file", "[Application]") {
     LocaleSuffixes ls("en_US");
@@ -73,6 +85,7 @@ TEST_CASE("Validate correct parsing of a simple file",
 
     REQUIRE(app.name == "Eagle");
     REQUIRE(app.exec == "eagle -style plastique");
+    REQUIRE(app.icon == "/opt/eagle/bin/eagleicon50.png");
     REQUIRE(!app.terminal);
 }
 
@@ -98,6 +111,9 @@ TEST_CASE("Tests correct parsing of localization (gimp)",
     REQUIRE(app.generic_name == "Bildredaktilo");
     REQUIRE(app.exec == "gimp-2.8 %U");
     REQUIRE(!app.terminal);
+    REQUIRE(app.mime_types.size() == 33);
+    REQUIRE(app.mime_types.front() == "image/bmp");
+    REQUIRE(app.mime_types.back() == "image/x-xcursor");
 }
 
 TEST_CASE("Regression test for issue #17, Hidden=false was read as Hidden=true",
@@ -195,3 +211,197 @@ TEST_CASE("Test opening desktop file with missing required keys",
     REQUIRE_THROWS(Application(
         TEST_FILES "applications/missing-entries.desktop", liner, ls, {}));
 }
+
+static void write_desktop_file(const std::string &path,
+                               const std::string &content) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file)
+        FAIL("Couldn't create " << path << ": " << strerror(errno));
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+}
+
+TEST_CASE("Test parsing limits", "[Application]") {
+    char tmpdirname[] = "/tmp/j4dd-application-limits-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string path = (std::string)tmpdirname + "/app.desktop";
+    const std::string header = "[Desktop Entry]\nName=App\nExec=app\n";
+
+    LocaleSuffixes ls("en_US");
+    LineReader liner;
+    ParsingLimits limits;
+    limits.max_file_size = 10000;
+    limits.max_line_length = 100;
+    limits.max_keys_per_group = 10;
+    limits.parse_time_budget = 0;
+
+    SECTION("Within limits") {
+        write_desktop_file(path, header + "Comment=" +
+                                     std::string(100 - 9, 'x') + "\n");
+        Application app(path.c_str(), liner, ls, {}, limits);
+        REQUIRE(app.name == "App");
+    }
+
+    SECTION("File size") {
+        write_desktop_file(path, header + std::string(10000, '#'));
+        REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, limits),
+                          limit_error);
+    }
+
+    SECTION("Line length") {
+        write_desktop_file(path, header + "Comment=" +
+                                     std::string(100 - 8, 'x') + "\n");
+        REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, limits),
+                          limit_error);
+    }
+
+    SECTION("Keys per group") {
+        std::string content = header;
+        for (int i = 0; i < 9; ++i)
+            content += "Comment[l" + std::to_string(i) + "]=x\n";
+        write_desktop_file(path, content);
+        REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, limits),
+                          limit_error);
+
+        // The limit applies to each group separately.
+        content = "";
+        for (int i = 0; i < 3; ++i)
+            content += "[Group " + std::to_string(i) + "]\na=b\nc=d\ne=f\n";
+        write_desktop_file(path, content + header);
+        REQUIRE_NOTHROW(Application(path.c_str(), liner, ls, {}, limits));
+    }
+
+    SECTION("Time budget") {
+        limits.disable();
+        limits.parse_time_budget = 1;
+        std::string content = header;
+        for (int i = 0; i < 2000000; ++i)
+            content += "#\n";
+        write_desktop_file(path, content);
+        REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, limits),
+                          limit_error);
+    }
+
+    SECTION("FIFO") {
+        if (mkfifo(path.c_str(), 0600) == -1)
+            FAIL("mkfifo: " << strerror(errno));
+        // This must not block.
+        REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, limits),
+                          invalid_error);
+    }
+}
+
+TEST_CASE("Test autostart desktop files", "[Application]") {
+    char tmpdirname[] = "/tmp/j4dd-application-autostart-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string path = (std::string)tmpdirname + "/app.desktop";
+    const std::string header = "[Desktop Entry]\nName=App\nExec=app\n";
+
+    LocaleSuffixes ls("en_US");
+    LineReader liner;
+
+    // NoDisplay hides the app from menus, but it is still autostarted.
+    write_desktop_file(path, header + "NoDisplay=true\n");
+    REQUIRE(Application(path.c_str(), liner, ls, {}).no_display);
+    REQUIRE_FALSE(Application(path.c_str(), liner, ls, {}, {},
+                              DesktopFileUse::autostart)
+                      .no_display);
+
+    write_desktop_file(path, header + "Hidden=true\n");
+    REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, {},
+                                  DesktopFileUse::autostart),
+                      disabled_error);
+
+    // X-GNOME-Autostart-enabled is ignored outside of autostart.
+    write_desktop_file(path, header + "X-GNOME-Autostart-enabled=false\n");
+    REQUIRE_NOTHROW(Application(path.c_str(), liner, ls, {}));
+    REQUIRE_THROWS_AS(Application(path.c_str(), liner, ls, {}, {},
+                                  DesktopFileUse::autostart),
+                      disabled_error);
+
+    write_desktop_file(path, header + "X-GNOME-Autostart-enabled=true\n");
+    REQUIRE_NOTHROW(Application(path.c_str(), liner, ls, {}, {},
+                                DesktopFileUse::autostart));
+}
+
+// Parse randomly mangled desktop files. Parsing must either succeed or fail
+// with one of the documented exceptions in bounded time.
+TEST_CASE("Fuzz Application parsing", "[Application]") {
+    char tmpdirname[] = "/tmp/j4dd-application-fuzz-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string path = (std::string)tmpdirname + "/app.desktop";
+
+    const std::string seed = "[Desktop Entry]\n"
+                             "Name=App\n"
+                             "Name[de]=Anwendung\n"
+                             "GenericName=Generic\n"
+                             "Exec=app --arg \\s %f\n"
+                             "OnlyShowIn=i3;sway;\n"
+                             "Terminal=false\n"
+                             "\n"
+                             "[Desktop Action New]\n"
+                             "Name=New\n";
+    const char interesting[] = "[]=\\;\n\0 #";
+
+    LocaleSuffixes ls("de_DE");
+    LineReader liner;
+    ParsingLimits limits;
+    limits.max_file_size = 64 * 1024;
+    limits.max_line_length = 1024;
+    limits.max_keys_per_group = 100;
+    limits.parse_time_budget = 50;
+
+    std::mt19937 generator(82);
+    for (int i = 0; i < 2000; ++i) {
+        std::string content = seed;
+        int mutations = 1 + generator() % 8;
+        for (int j = 0; j < mutations; ++j) {
+            size_t position = generator() % (content.size() + 1);
+            switch (generator() % 5) {
+            case 0: // Insert an interesting character.
+                content.insert(
+                    position, 1,
+                    interesting[generator() % (sizeof interesting - 1)]);
+                break;
+            case 1: // Remove a character.
+                if (position < content.size())
+                    content.erase(position, 1);
+                break;
+            case 2: // Insert a long run of characters.
+                content.insert(position, generator() % 4096, 'x');
+                break;
+            case 3: // Insert many keys.
+                for (int k = generator() % 200; k > 0; --k)
+                    content.insert(position, "Name[x]=y\n");
+                break;
+            case 4: // Cut the file.
+                content.resize(position);
+                break;
+            }
+        }
+        write_desktop_file(path, content);
+
+        INFO("Iteration " << i);
+        auto start = std::chrono::steady_clock::now();
+        try {
+            Application app(path.c_str(), liner, ls, {"i3"}, limits);
+            REQUIRE_FALSE(app.name.empty());
+        } catch (const invalid_error &) {
+        } catch (const disabled_error &) {
+        }
+        REQUIRE(std::chrono::steady_clock::now() - start <
+                std::chrono::seconds(1));
+    }
+}
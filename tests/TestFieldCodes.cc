@@ -95,6 +95,19 @@ TEST_CASE("Tests proper handling of special characters",
     REQUIRE(result == cmp);
 }
 
+TEST_CASE("Test field codes with split arguments", "[ApplicationRunner]") {
+    LocaleSuffixes ls("en_US");
+    LineReader liner;
+    Application app(TEST_FILES "applications/gimp.desktop", liner, ls, {});
+
+    // Arguments received in launch requests may contain spaces.
+    auto args = CMDLineAssembly::convert_exec_to_command(app.exec);
+    expand_field_codes(args, app, stringlist_t{"file name", "second"});
+
+    stringlist_t cmp({"gimp-2.8", "file name", "second"});
+    REQUIRE(args == cmp);
+}
+
 TEST_CASE("Test field codes", "[ApplicationRunner]") {
     LocaleSuffixes ls("en_US");
     LineReader liner;
@@ -124,3 +137,30 @@ TEST_CASE("Regression test for issue #18, %c was not escaped",
     stringlist_t cmp({"1234", "--caption", "Regression Test 18"});
     REQUIRE(result == cmp);
 }
+
+TEST_CASE("Test %i field code", "[ApplicationRunner]") {
+    LocaleSuffixes ls("en_US");
+    LineReader liner;
+
+    SECTION("Icon is present") {
+        Application app(TEST_FILES "applications/icon.desktop", liner, ls, {});
+
+        auto args = CMDLineAssembly::convert_exec_to_command(app.exec);
+        expand_field_codes(args, app, "");
+
+        stringlist_t cmp({"true", "--icon", "eagle", "--name=Icon"});
+        REQUIRE(args == cmp);
+    }
+
+    SECTION("Icon is missing") {
+        Application app(TEST_FILES "applications/icon.desktop", liner, ls, {});
+        app.icon.clear();
+
+        auto args = CMDLineAssembly::convert_exec_to_command(app.exec);
+        expand_field_codes(args, app, "");
+
+        // The argument following %i must still be expanded.
+        stringlist_t cmp({"true", "--name=Icon"});
+        REQUIRE(args == cmp);
+    }
+}
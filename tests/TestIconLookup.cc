@@ -0,0 +1,127 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+#include "generated/tests_config.hh"
+
+#include "FSUtils.hh"
+#include "IconLookup.hh"
+#include "Utilities.hh"
+
+#define ICONS TEST_FILES "icons/"
+
+TEST_CASE("Test icon lookup", "[IconLookup]") {
+    IconLookup icons("testtheme", 48, {ICONS}, "");
+
+    REQUIRE_FALSE(icons.is_loaded_from_cache());
+
+    // Exact size match, PNG is preferred over SVG.
+    REQUIRE(icons.lookup("eagle") == ICONS "testtheme/48x48/apps/eagle.png");
+    // Scalable directory
+    REQUIRE(icons.lookup("gimp") == ICONS "testtheme/scalable/apps/gimp.svg");
+    // Inherited theme
+    REQUIRE(icons.lookup("htop") == ICONS "hicolor/48x48/apps/htop.png");
+    // Extension in Icon key
+    REQUIRE(icons.lookup("htop.png") == ICONS "hicolor/48x48/apps/htop.png");
+    // Fallback icon
+    REQUIRE(icons.lookup("fallback") == ICONS "fallback.xpm");
+    // Absolute paths are kept as is.
+    REQUIRE(icons.lookup("/some/icon.png") == "/some/icon.png");
+
+    REQUIRE(icons.lookup("nonexistent").empty());
+    REQUIRE(icons.lookup("").empty());
+}
+
+TEST_CASE("Test icon lookup size matching", "[IconLookup]") {
+    IconLookup icons("testtheme", 16, {ICONS}, "");
+
+    REQUIRE(icons.lookup("eagle") == ICONS "testtheme/16x16/apps/eagle.png");
+    // Icons in the current theme take precedence over icons in inherited
+    // themes even when they have a worse size match.
+    REQUIRE(icons.lookup("gimp") == ICONS "testtheme/scalable/apps/gimp.svg");
+}
+
+TEST_CASE("Test icon cache", "[IconLookup]") {
+    // The themes are modified below, they are copied to keep the source tree
+    // untouched.
+    char tmpdirname[] = "/tmp/j4dd-icon-cache-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    FSUtils::copy_directory_recursive(ICONS, tmpdirname);
+    const std::string icons_dir = tmpdirname + std::string("/");
+
+    FSUtils::TempFile cache("j4dd-icon-cache-test");
+
+    {
+        IconLookup icons("testtheme", 48, {icons_dir}, cache.get_name());
+        REQUIRE_FALSE(icons.is_loaded_from_cache());
+    }
+
+    {
+        IconLookup icons("testtheme", 48, {icons_dir}, cache.get_name());
+        REQUIRE(icons.is_loaded_from_cache());
+        REQUIRE(icons.lookup("eagle") ==
+                icons_dir + "testtheme/48x48/apps/eagle.png");
+        REQUIRE(icons.lookup("htop") ==
+                icons_dir + "hicolor/48x48/apps/htop.png");
+        REQUIRE(icons.lookup("fallback") == icons_dir + "fallback.xpm");
+    }
+
+    // The cache is specific to the requested size.
+    {
+        IconLookup icons("testtheme", 16, {icons_dir}, cache.get_name());
+        REQUIRE_FALSE(icons.is_loaded_from_cache());
+        REQUIRE(icons.lookup("eagle") ==
+                icons_dir + "testtheme/16x16/apps/eagle.png");
+    }
+
+    // This simulates a long running process (--wait-on).
+    IconLookup running("testtheme", 16, {icons_dir}, cache.get_name());
+    REQUIRE(running.is_loaded_from_cache());
+    REQUIRE_FALSE(running.is_outdated());
+
+    // Adding an icon must invalidate the cache.
+    std::string new_icon = icons_dir + "hicolor/48x48/apps/new-icon.png";
+    FILE *file = fopen(new_icon.c_str(), "w");
+    if (!file)
+        FAIL("Couldn't create " << new_icon << ": " << strerror(errno));
+    fclose(file);
+
+    REQUIRE(running.is_outdated());
+    running.rebuild();
+    REQUIRE_FALSE(running.is_outdated());
+    REQUIRE(running.lookup("new-icon") == new_icon);
+
+    // rebuild() has updated the cache.
+    {
+        IconLookup icons("testtheme", 16, {icons_dir}, cache.get_name());
+        REQUIRE(icons.is_loaded_from_cache());
+        REQUIRE(icons.lookup("new-icon") == new_icon);
+    }
+}
@@ -0,0 +1,92 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <limits.h>
+#include <stdexcept>
+#include <string>
+
+#include "LaunchRequest.hh"
+#include "Utilities.hh"
+
+using LaunchRequest::Request;
+
+TEST_CASE("Test launch request encoding", "[LaunchRequest]") {
+    std::string encoded =
+        LaunchRequest::encode(Request("firefox.desktop", {"a b", "c"}));
+    REQUIRE(encoded ==
+            std::string("launch\0firefox.desktop\0a b\0c\0\0", 30));
+
+    REQUIRE_THROWS_AS(LaunchRequest::encode(Request("", {})),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(LaunchRequest::encode(Request("a.desktop", {""})),
+                      std::invalid_argument);
+    std::string long_arg(PIPE_BUF, 'x');
+    REQUIRE_THROWS_AS(LaunchRequest::encode(Request("a.desktop", {long_arg})),
+                      std::invalid_argument);
+}
+
+TEST_CASE("Test launch request parsing", "[LaunchRequest]") {
+    SECTION("Legacy commands") {
+        auto input = LaunchRequest::parse("\n\nq");
+        REQUIRE(input.requests.empty());
+        REQUIRE(input.command == 'q');
+
+        REQUIRE_FALSE(LaunchRequest::parse("").command);
+        // Text which looks like the header but isn't null terminated.
+        REQUIRE(LaunchRequest::parse("launch").command == 'h');
+    }
+
+    SECTION("Requests") {
+        std::string data =
+            LaunchRequest::encode(Request("a.desktop", {"file"})) + "x" +
+            LaunchRequest::encode(Request("b.desktop", {}));
+        auto input = LaunchRequest::parse(data);
+        REQUIRE(input.command == 'x');
+        REQUIRE(input.requests.size() == 2);
+        REQUIRE(input.requests[0].desktop_id == "a.desktop");
+        REQUIRE(input.requests[0].args == stringlist_t{"file"});
+        REQUIRE(input.requests[1].desktop_id == "b.desktop");
+        REQUIRE(input.requests[1].args.empty());
+    }
+
+    SECTION("Open requests") {
+        std::string data =
+            LaunchRequest::encode(Request(stringlist_t{"/a.pdf", "https://b"}));
+        REQUIRE(data == std::string("open\0/a.pdf\0https://b\0\0", 23));
+        auto input = LaunchRequest::parse(data + 'q');
+        REQUIRE(input.command == 'q');
+        REQUIRE(input.requests.size() == 1);
+        REQUIRE(input.requests[0].type == LaunchRequest::Type::open);
+        REQUIRE(input.requests[0].desktop_id.empty());
+        REQUIRE(input.requests[0].args == stringlist_t{"/a.pdf", "https://b"});
+
+        REQUIRE_THROWS_AS(LaunchRequest::encode(Request(stringlist_t{})),
+                          std::invalid_argument);
+    }
+
+    SECTION("Malformed requests") {
+        auto input = LaunchRequest::parse(std::string("launch\0\0r", 9));
+        REQUIRE(input.requests.empty());
+        REQUIRE(input.command == 'r');
+
+        input = LaunchRequest::parse(std::string("launch\0a.desktop\0arg", 20));
+        REQUIRE(input.requests.empty());
+        REQUIRE_FALSE(input.command);
+    }
+}
@@ -0,0 +1,127 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <errno.h>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+#include "LineReader.hh"
+#include "Utilities.hh"
+
+using namespace std::string_literals;
+
+// Create an anonymous temporary file with the given content.
+static std::unique_ptr<FILE, fclose_deleter>
+make_temp_file(const std::string &content) {
+    std::unique_ptr<FILE, fclose_deleter> file(tmpfile());
+    if (!file)
+        FAIL("tmpfile: " << strerror(errno));
+    if (fwrite(content.data(), 1, content.size(), file.get()) !=
+        content.size())
+        FAIL("fwrite: " << strerror(errno));
+    rewind(file.get());
+    return file;
+}
+
+static std::vector<std::string> read_lines_from_memory(LineReader &liner) {
+    std::vector<std::string> result;
+    ssize_t length;
+    while ((length = liner.next_line()) != -1)
+        result.emplace_back(liner.get_lineptr(), length);
+    return result;
+}
+
+TEST_CASE("Test reading whole file", "[LineReader]") {
+    auto file = make_temp_file("first\n\nnull\0byte\nlast"s);
+    LineReader liner;
+
+    REQUIRE(liner.read_file(fileno(file.get()), 0) == 21);
+    REQUIRE(read_lines_from_memory(liner) ==
+            std::vector<std::string>{"first\n", "\n", "null\0byte\n"s, "last"});
+    // The last line is terminated.
+    REQUIRE(liner.get_lineptr() == "last"s);
+    REQUIRE(liner.next_line() == -1);
+
+    // getline() can still be used.
+    rewind(file.get());
+    REQUIRE(liner.getline(file.get()) == 6);
+    REQUIRE(liner.get_lineptr() == "first\n"s);
+}
+
+TEST_CASE("Test reading whole file with a size limit", "[LineReader]") {
+    auto file = make_temp_file("[Desktop Entry]\nName=" +
+                               std::string(16 * 1024 * 1024, 'x') + "\n");
+    LineReader liner;
+
+    // Only one byte more than allowed is read.
+    REQUIRE(liner.read_file(fileno(file.get()), 4096) == 4097);
+    REQUIRE(liner.next_line() == 16);
+    REQUIRE(liner.next_line() == 4097 - 16);
+    REQUIRE(liner.next_line() == -1);
+
+    REQUIRE(lseek(fileno(file.get()), 0, SEEK_SET) == 0);
+    REQUIRE(liner.read_file(fileno(file.get()), 0) == 16 * 1024 * 1024 + 22);
+}
+
+TEST_CASE("Test reading empty file", "[LineReader]") {
+    auto file = make_temp_file("");
+    LineReader liner;
+
+    REQUIRE(liner.read_file(fileno(file.get()), 100) == 0);
+    REQUIRE(liner.next_line() == -1);
+}
+
+// Compare next_line() with getline() on random input.
+TEST_CASE("Fuzz reading whole file", "[LineReader]") {
+    std::mt19937 generator(4);
+    const char alphabet[] = "ab\n\n\0=[]";
+    std::uniform_int_distribution<size_t> character(0, sizeof alphabet - 2);
+    std::uniform_int_distribution<size_t> length(0, 20000);
+
+    // The same LineReader is reused to make sure that no state is left over
+    // between files.
+    LineReader liner;
+    for (int i = 0; i < 300; ++i) {
+        INFO("Iteration " << i);
+        std::string content;
+        content.resize(length(generator));
+        for (char &c : content) {
+            // Make long lines likely too.
+            c = generator() % 8 == 0 ? alphabet[character(generator)] : 'x';
+        }
+        auto file = make_temp_file(content);
+
+        std::vector<std::string> expected;
+        ssize_t line_length;
+        while ((line_length = liner.getline(file.get())) != -1)
+            expected.emplace_back(liner.get_lineptr(), line_length);
+
+        REQUIRE(lseek(fileno(file.get()), 0, SEEK_SET) == 0);
+        REQUIRE(liner.read_file(fileno(file.get()), 0) ==
+                (ssize_t)content.size());
+        REQUIRE(read_lines_from_memory(liner) == expected);
+    }
+}
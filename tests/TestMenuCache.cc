@@ -0,0 +1,119 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FSUtils.hh"
+#include "MenuCache.hh"
+#include "Utilities.hh"
+
+// The key and the menu may contain newlines and null bytes.
+static const char menu_data[] = "Firefox\0icon\x1f/firefox.png\nChromium\n";
+static const std::string cached_menu(menu_data, sizeof menu_data - 1);
+static const char key_data[] = "key\0with\nnewline";
+static const std::string cache_key(key_data, sizeof key_data - 1);
+
+TEST_CASE("Test menu cache", "[MenuCache]") {
+    char tmpdirname[] = "/tmp/j4dd-menu-cache-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+
+    std::string dir = (std::string)tmpdirname + "/applications/";
+    std::string missing_dir = (std::string)tmpdirname + "/missing/";
+    std::string history = (std::string)tmpdirname + "/history";
+    std::string cache_path = (std::string)tmpdirname + "/cache";
+
+    if (mkdir(dir.c_str(), 0700) == -1)
+        FAIL("mkdir: " << strerror(errno));
+    FILE *hist = fopen(history.c_str(), "w");
+    if (!hist)
+        FAIL("Couldn't create " << history << ": " << strerror(errno));
+    fputs("history\n", hist);
+    fclose(hist);
+
+    {
+        MenuCache cache(cache_path, cache_key);
+        REQUIRE_FALSE(cache.load());
+        cache.watch(dir);
+        cache.watch(missing_dir);
+        cache.watch(history);
+        cache.save(cached_menu);
+    }
+
+    SECTION("Valid cache") {
+        MenuCache cache(cache_path, cache_key);
+        auto loaded = cache.load();
+        REQUIRE(loaded);
+        REQUIRE(*loaded == cached_menu);
+    }
+
+    SECTION("Different key") {
+        MenuCache cache(cache_path, "other key");
+        REQUIRE_FALSE(cache.load());
+    }
+
+    SECTION("Modified directory") {
+        // Set the mtime explicitly. Changing the directory could keep its
+        // mtime the same on filesystems with coarse timestamps.
+        struct timespec times[2] = {
+            {0, UTIME_OMIT},
+            {1000, 0}
+        };
+        if (utimensat(AT_FDCWD, dir.c_str(), times, 0) == -1)
+            FAIL("utimensat: " << strerror(errno));
+        MenuCache cache(cache_path, cache_key);
+        REQUIRE_FALSE(cache.load());
+    }
+
+    SECTION("Created directory") {
+        if (mkdir(missing_dir.c_str(), 0700) == -1)
+            FAIL("mkdir: " << strerror(errno));
+        MenuCache cache(cache_path, cache_key);
+        REQUIRE_FALSE(cache.load());
+    }
+
+    SECTION("Modified history") {
+        // The size of the file changes.
+        hist = fopen(history.c_str(), "a");
+        if (!hist)
+            FAIL("Couldn't open " << history << ": " << strerror(errno));
+        fputs("more history\n", hist);
+        fclose(hist);
+        MenuCache cache(cache_path, cache_key);
+        REQUIRE_FALSE(cache.load());
+    }
+
+    SECTION("Truncated cache") {
+        if (truncate(cache_path.c_str(), 50) == -1)
+            FAIL("truncate: " << strerror(errno));
+        MenuCache cache(cache_path, cache_key);
+        REQUIRE_FALSE(cache.load());
+    }
+}
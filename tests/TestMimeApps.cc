@@ -0,0 +1,143 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <optional>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "generated/tests_config.hh"
+
+#include "AppManager.hh"
+#include "LocaleSuffixes.hh"
+#include "MimeApps.hh"
+#include "Utilities.hh"
+
+#define MIME_APPS TEST_FILES "mime/applications/"
+#define MIME_LISTS TEST_FILES "mime/lists/"
+
+TEST_CASE("Test default apps", "[MimeApps]") {
+    AppManager apps(
+        {
+            {MIME_APPS,
+             {MIME_APPS "viewer.desktop", MIME_APPS "editor.desktop",
+              MIME_APPS "browser.desktop", MIME_APPS "sub/reader.desktop"}}
+    },
+        {}, LocaleSuffixes("en_US"));
+    MimeApps mimeapps({MIME_LISTS "high/test-mimeapps.list",
+                       MIME_LISTS "high/mimeapps.list",
+                       MIME_LISTS "nonexistent/mimeapps.list",
+                       MIME_LISTS "low/mimeapps.list"});
+
+    // Uninstalled apps are skipped.
+    REQUIRE(mimeapps.get_default_app("text/plain", apps) == "editor.desktop");
+    // Files of higher precedence win.
+    REQUIRE(mimeapps.get_default_app("image/png", apps) == "viewer.desktop");
+    // The first associated app is used when there's no default app.
+    REQUIRE(mimeapps.get_default_app("application/pdf", apps) ==
+            "browser.desktop");
+    REQUIRE(mimeapps.get_default_app("x-scheme-handler/https", apps) ==
+            "browser.desktop");
+    REQUIRE(mimeapps.get_default_app("video/mp4", apps).empty());
+}
+
+TEST_CASE("Test associated apps", "[MimeApps]") {
+    AppManager apps(
+        {
+            {MIME_APPS,
+             {MIME_APPS "viewer.desktop", MIME_APPS "editor.desktop",
+              MIME_APPS "browser.desktop", MIME_APPS "sub/reader.desktop"}}
+    },
+        {}, LocaleSuffixes("en_US"));
+    MimeApps mimeapps({MIME_LISTS "high/test-mimeapps.list",
+                       MIME_LISTS "high/mimeapps.list",
+                       MIME_LISTS "low/mimeapps.list"});
+
+    // Added Associations precede desktop files, unknown groups are ignored.
+    REQUIRE(mimeapps.get_associated_apps("text/html", apps) ==
+            stringlist_t{"editor.desktop", "browser.desktop"});
+    // viewer.desktop is removed by a file of higher precedence.
+    REQUIRE(mimeapps.get_associated_apps("application/pdf", apps) ==
+            stringlist_t{"browser.desktop", "sub-reader.desktop"});
+    // Desktop files are sorted by desktop ID.
+    REQUIRE(mimeapps.get_associated_apps("image/png", apps) ==
+            stringlist_t{"editor.desktop", "viewer.desktop"});
+
+    // Associations of removed apps disappear.
+    apps.remove(MIME_APPS "sub/reader.desktop", MIME_APPS);
+    REQUIRE(mimeapps.get_associated_apps("application/pdf", apps) ==
+            stringlist_t{"browser.desktop"});
+}
+
+TEST_CASE("Test NoDisplay handlers", "[MimeApps]") {
+    // Handlers are often hidden from menus with NoDisplay=true, they must
+    // still be usable.
+    AppManager apps(
+        {
+            {MIME_APPS,
+             {MIME_APPS "editor.desktop", MIME_APPS "handler.desktop"}}
+    },
+        {}, LocaleSuffixes("en_US"));
+    MimeApps mimeapps({MIME_LISTS "high/mimeapps.list"});
+
+    REQUIRE(apps.view_name_app_mapping().count("Handler") == 0);
+    REQUIRE(mimeapps.get_default_app("text/markdown", apps) ==
+            "handler.desktop");
+    REQUIRE(mimeapps.get_default_app("x-scheme-handler/mailto", apps) ==
+            "handler.desktop");
+    REQUIRE(mimeapps.get_associated_apps("text/markdown", apps) ==
+            stringlist_t{"handler.desktop"});
+}
+
+TEST_CASE("Test mimeapps.list lookup", "[MimeApps]") {
+    // Restore the environment afterwards, other tests may depend on it.
+    std::vector<std::pair<const char *, std::optional<std::string>>> saved;
+    for (const char *var : {"HOME", "XDG_CONFIG_HOME", "XDG_CONFIG_DIRS",
+                            "XDG_DATA_HOME", "XDG_DATA_DIRS"}) {
+        const char *value = getenv(var);
+        saved.emplace_back(var, value ? std::optional<std::string>(value)
+                                      : std::nullopt);
+    }
+    OnExit restore_env = [&saved]() {
+        for (const auto &[var, value] : saved) {
+            if (value)
+                setenv(var, value->c_str(), 1);
+            else
+                unsetenv(var);
+        }
+    };
+
+    setenv("HOME", "/home/user", 1);
+    unsetenv("XDG_CONFIG_HOME");
+    setenv("XDG_CONFIG_DIRS", "/etc/xdg", 1);
+    setenv("XDG_DATA_HOME", "/data/home/", 1);
+    setenv("XDG_DATA_DIRS", "/usr/share", 1);
+
+    REQUIRE(MimeApps::get_files({"sway"}) ==
+            stringlist_t{"/home/user/.config/sway-mimeapps.list",
+                         "/home/user/.config/mimeapps.list",
+                         "/etc/xdg/sway-mimeapps.list",
+                         "/etc/xdg/mimeapps.list",
+                         "/data/home/applications/sway-mimeapps.list",
+                         "/data/home/applications/mimeapps.list",
+                         "/usr/share/applications/sway-mimeapps.list",
+                         "/usr/share/applications/mimeapps.list"});
+}
@@ -18,16 +18,22 @@
 #include <catch2/catch_test_macros.hpp>
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 // IWYU pragma: no_include <vector>
 // IWYU pragma: no_include <string>
 
 #include "generated/tests_config.hh"
 
+#include "FSUtils.hh"
 #include "NotifyBase.hh"
 #include "Utilities.hh"
 
@@ -46,7 +52,11 @@ TEST_CASE("Test detection of file creation and deletion of a subdirectory of "
 #ifdef USE_KQUEUE
     NotifyKqueue notify(search_path);
 #else
-    NotifyInotify notify(search_path);
+    // Desktop files existing before the watches are registered are reported
+    // by the resync, they are irrelevant here.
+    NotifyInotify notify(search_path, {}, 0);
+    while (notify.has_pending_watches())
+        notify.register_pending_watches();
 #endif
 
     // Try to delete TEST_FILENAME if it exists. A failed test might not have
@@ -99,3 +109,134 @@ TEST_CASE("Test detection of file creation and deletion of a subdirectory of "
     REQUIRE(found);
     REQUIRE(poll(&towait, 1, 0) == 0);
 }
+
+#ifndef USE_KQUEUE
+TEST_CASE("Test deferred watch registration and resync", "[Notify]") {
+    char tmpdirname[] = "/tmp/j4dd-notify-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string base = (std::string)tmpdirname + '/';
+
+    auto make_file = [](const std::string &path) {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+            FAIL("Couldn't create " << path << ": " << strerror(errno));
+        // Subdirectories are watched for IN_MODIFY, not for IN_CREATE.
+        fmt::print(file, "DATA");
+        fclose(file);
+    };
+
+    // Create a tree with more directories than are watched at once.
+    stringlist_t known;
+    for (int i = 0; i < 100; ++i) {
+        std::string dir = base + "dir" + std::to_string(i);
+        if (mkdir(dir.c_str(), 0700) == -1)
+            FAIL("mkdir: " << strerror(errno));
+        make_file(dir + "/app.desktop");
+        known.push_back(dir + "/app.desktop");
+    }
+    make_file(base + "unchanged.desktop");
+    known.push_back(base + "unchanged.desktop");
+    make_file(base + "deleted.desktop");
+    known.push_back(base + "deleted.desktop");
+    make_file(base + "modified.desktop");
+    known.push_back(base + "modified.desktop");
+
+    // Timestamps are compared with a second of tolerance. Instead of waiting
+    // for the known files to become older than that, the scan is pretended to
+    // have started a bit later and modified.desktop is modified in the future.
+    time_t scan_start = time(NULL) + 2;
+
+    NotifyInotify notify({base}, {known}, scan_start);
+
+    // These changes happen before the directories are watched.
+    if (unlink((base + "deleted.desktop").c_str()) == -1)
+        FAIL("unlink: " << strerror(errno));
+    timespec modified_time[2] = {
+        {scan_start + 10, 0},
+        {scan_start + 10, 0}
+    };
+    if (utimensat(AT_FDCWD, (base + "modified.desktop").c_str(),
+                  modified_time, 0) == -1)
+        FAIL("utimensat: " << strerror(errno));
+    make_file(base + "dir99/created.desktop");
+
+    std::vector<NotifyBase::FileChange> changes;
+    int batches = 0;
+    while (notify.has_pending_watches()) {
+        auto batch = notify.register_pending_watches();
+        changes.insert(changes.end(), batch.begin(), batch.end());
+        ++batches;
+    }
+    REQUIRE(batches > 1);
+
+    std::vector<std::string> modified, deleted;
+    for (const auto &change : changes) {
+        REQUIRE(change.rank == 0);
+        if (change.status == NotifyBase::modified)
+            modified.push_back(change.name);
+        else
+            deleted.push_back(change.name);
+    }
+    std::sort(modified.begin(), modified.end());
+    REQUIRE(modified == std::vector<std::string>{"dir99/created.desktop",
+                                                 "modified.desktop"});
+    REQUIRE(deleted == std::vector<std::string>{"deleted.desktop"});
+
+    // All directories are watched now.
+    pollfd towait = {notify.getfd(), POLLIN, 0};
+    REQUIRE(poll(&towait, 1, 0) == 0);
+    make_file(base + "dir42/new.desktop");
+    // The change may be reported in several batches of events. Wait for it
+    // for at most 10 seconds.
+    time_t deadline = time(NULL) + 10;
+    bool found = false;
+    while (!found && time(NULL) < deadline) {
+        if (poll(&towait, 1, 100) != 1)
+            continue;
+        for (const auto &change : notify.getchanges()) {
+            if (change.name == "dir42/new.desktop")
+                found = true;
+        }
+    }
+    REQUIRE(found);
+}
+
+TEST_CASE("Test resync of a large directory", "[Notify]") {
+    char tmpdirname[] = "/tmp/j4dd-notify-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string base = (std::string)tmpdirname + '/';
+
+    constexpr int file_count = 1000;
+    for (int i = 0; i < file_count; ++i) {
+        std::string path = base + "app" + std::to_string(i) + ".desktop";
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+            FAIL("Couldn't create " << path << ": " << strerror(errno));
+        fclose(file);
+    }
+
+    // None of the files is known, all of them are reported. A single
+    // directory mustn't be resynced in one step.
+    NotifyInotify notify({base}, {{}}, time(NULL));
+    std::vector<std::string> modified;
+    while (notify.has_pending_watches()) {
+        auto batch = notify.register_pending_watches();
+        REQUIRE(batch.size() < file_count);
+        for (const auto &change : batch) {
+            REQUIRE(change.status == NotifyBase::modified);
+            modified.push_back(change.name);
+        }
+    }
+    std::sort(modified.begin(), modified.end());
+    REQUIRE(std::unique(modified.begin(), modified.end()) == modified.end());
+    REQUIRE(modified.size() == file_count);
+}
+#endif
@@ -0,0 +1,123 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <errno.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+#include "generated/tests_config.hh"
+
+#include "FSUtils.hh"
+#include "ParallelFileFinder.hh"
+#include "Utilities.hh"
+
+TEST_CASE("Test ParallelFileFinder on test files", "[ParallelFileFinder]") {
+    stringlist_t expected = ParallelFileFinder::find(TEST_FILES, ".desktop", 1);
+    REQUIRE(std::is_sorted(expected.begin(), expected.end()));
+    for (const char *path : {TEST_FILES "a/applications/firefox.desktop",
+                             TEST_FILES "mime/applications/sub/reader.desktop"})
+        REQUIRE(std::find(expected.begin(), expected.end(), path) !=
+                expected.end());
+    for (const std::string &path : expected) {
+        REQUIRE(endswith(path, ".desktop"));
+        // Hidden files and directories are skipped.
+        REQUIRE(path.find("/.", sizeof TEST_FILES - 2) == std::string::npos);
+    }
+
+    REQUIRE(ParallelFileFinder::find(TEST_FILES, ".desktop", 4) == expected);
+}
+
+TEST_CASE("Test ParallelFileFinder", "[ParallelFileFinder]") {
+    char tmpdirname[] = "/tmp/j4dd-parallel-file-finder-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string base = (std::string)tmpdirname + '/';
+
+    // Create a wide and deep tree to give threads something to steal.
+    stringlist_t expected;
+    stringlist_t expected_dirs{base};
+    auto make_dir = [&expected_dirs](const std::string &path) {
+        if (mkdir(path.c_str(), 0700) == -1)
+            FAIL("mkdir " << path << ": " << strerror(errno));
+        expected_dirs.push_back(path + '/');
+    };
+    auto make_file = [](const std::string &path) {
+        FILE *file = fopen(path.c_str(), "w");
+        if (!file)
+            FAIL("Couldn't create " << path << ": " << strerror(errno));
+        fclose(file);
+    };
+    for (int vendor = 0; vendor < 20; ++vendor) {
+        std::string vendor_dir = base + "vendor" + std::to_string(vendor);
+        make_dir(vendor_dir);
+        std::string dir = vendor_dir;
+        for (int depth = 0; depth < 5; ++depth) {
+            for (int i = 0; i < 10; ++i) {
+                std::string file = dir + "/app" + std::to_string(i);
+                make_file(file + ".desktop");
+                expected.push_back(file + ".desktop");
+                make_file(file + ".png");
+            }
+            dir += "/sub";
+            make_dir(dir);
+        }
+    }
+    // Hidden files and directories are skipped.
+    make_file(base + ".hidden.desktop");
+    if (mkdir((base + ".hidden").c_str(), 0700) == -1)
+        FAIL("mkdir: " << strerror(errno));
+    make_file(base + ".hidden/app.desktop");
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(expected_dirs.begin(), expected_dirs.end());
+
+    for (unsigned int threads : {1, 2, 8}) {
+        INFO("Thread count: " << threads);
+        stringlist_t dirs;
+        stringlist_t result = ParallelFileFinder::find(
+            base, ".desktop", threads,
+            [&dirs](const std::string &path) { dirs.push_back(path); });
+        REQUIRE(result == expected);
+        std::sort(dirs.begin(), dirs.end());
+        REQUIRE(dirs == expected_dirs);
+    }
+
+    SECTION("Exceptions") {
+        // Exceptions thrown in the callback are propagated.
+        REQUIRE_THROWS_AS(
+            ParallelFileFinder::find(base, ".desktop", 4,
+                                     [&base](const std::string &path) {
+                                         if (path != base)
+                                             throw std::logic_error("test");
+                                     }),
+            std::logic_error);
+        REQUIRE_THROWS_AS(
+            ParallelFileFinder::find(base + "nonexistent/", ".desktop", 4),
+            std::runtime_error);
+    }
+}
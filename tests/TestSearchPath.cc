@@ -57,3 +57,16 @@ TEST_CASE("Check SearchPath honors XDG_DATA_DIRS", "[SearchPath]") {
                           "/my/usr/share/applications/",
                       });
 }
+
+TEST_CASE("Check autostart search path", "[SearchPath]") {
+    REQUIRE(build_autostart_search_path("", "/home/testuser", "",
+                                        always_exists) ==
+            std::vector<std::string>{"/home/testuser/.config/autostart/",
+                                     "/etc/xdg/autostart/"});
+
+    REQUIRE(build_autostart_search_path("/my/config/", "/home/testuser",
+                                        "/my/xdg:/other/xdg/", always_exists) ==
+            std::vector<std::string>{"/my/config/autostart/",
+                                     "/my/xdg/autostart/",
+                                     "/other/xdg/autostart/"});
+}
@@ -0,0 +1,117 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_message.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+#include "generated/tests_config.hh"
+
+#include "FSUtils.hh"
+#include "SharedMimeInfo.hh"
+#include "Utilities.hh"
+
+#define MIME_DB TEST_FILES "mime/db/"
+
+TEST_CASE("Test MIME type detection", "[SharedMimeInfo]") {
+    SharedMimeInfo mime({MIME_DB});
+
+    REQUIRE(mime.get_mime_type("/nonexistent/image.png") == "image/png");
+    // Globs are case insensitive by default.
+    REQUIRE(mime.get_mime_type("/nonexistent/IMAGE.PNG") == "image/png");
+    // Case sensitive globs
+    REQUIRE(mime.get_mime_type("/nonexistent/main.c") == "text/x-csrc");
+    REQUIRE(mime.get_mime_type("/nonexistent/main.C") == "text/x-c++src");
+    // The longest glob wins.
+    REQUIRE(mime.get_mime_type("/nonexistent/a.tar.gz") ==
+            "application/x-compressed-tar");
+    REQUIRE(mime.get_mime_type("/nonexistent/a.gz") == "application/gzip");
+    // Literal names and patterns
+    REQUIRE(mime.get_mime_type("/nonexistent/Makefile") == "text/x-makefile");
+    REQUIRE(mime.get_mime_type("/nonexistent/README.md") == "text/x-readme");
+
+    REQUIRE(mime.get_mime_type(MIME_DB) == "inode/directory");
+    REQUIRE(mime.get_mime_type("/nonexistent/file.unknown") ==
+            "application/octet-stream");
+}
+
+TEST_CASE("Test MIME type detection of unknown files", "[SharedMimeInfo]") {
+    SharedMimeInfo mime({MIME_DB});
+
+    FSUtils::TempFile text("j4dd-mime-text-test");
+    const char text_content[] = "Some text\n";
+    REQUIRE(writen(text.get_internal_fd(), text_content,
+                   sizeof text_content - 1) == sizeof text_content - 1);
+    REQUIRE(mime.get_mime_type(text.get_name()) == "text/plain");
+
+    FSUtils::TempFile binary("j4dd-mime-binary-test");
+    const char binary_content[] = "\x7f" "ELF\x02\x01\x01";
+    REQUIRE(writen(binary.get_internal_fd(), binary_content,
+                   sizeof binary_content) == sizeof binary_content);
+    REQUIRE(mime.get_mime_type(binary.get_name()) ==
+            "application/octet-stream");
+}
+
+TEST_CASE("Test MIME type inheritance", "[SharedMimeInfo]") {
+    SharedMimeInfo mime({MIME_DB});
+
+    REQUIRE(mime.get_type_chain("text/x-c++src") ==
+            stringlist_t{"text/x-c++src", "text/x-csrc", "text/plain",
+                         "application/octet-stream"});
+    // text/* types are implicitly subclasses of text/plain.
+    REQUIRE(mime.get_type_chain("text/x-makefile") ==
+            stringlist_t{"text/x-makefile", "text/plain",
+                         "application/octet-stream"});
+    REQUIRE(mime.get_type_chain("image/png") ==
+            stringlist_t{"image/png", "application/octet-stream"});
+    REQUIRE(mime.get_type_chain("inode/directory") ==
+            stringlist_t{"inode/directory"});
+    REQUIRE(mime.get_type_chain("x-scheme-handler/https") ==
+            stringlist_t{"x-scheme-handler/https"});
+}
+
+TEST_CASE("Test SharedMimeInfo change detection", "[SharedMimeInfo]") {
+    char tmpdirname[] = "/tmp/j4dd-mime-test-XXXXXX";
+    if (mkdtemp(tmpdirname) == NULL)
+        SKIP("mkdtemp: " << strerror(errno));
+    OnExit rmdir_handler = [&tmpdirname]() {
+        FSUtils::rmdir_recursive(tmpdirname);
+    };
+    std::string base = tmpdirname + std::string("/");
+
+    SharedMimeInfo mime({base});
+    REQUIRE_FALSE(mime.is_outdated());
+    REQUIRE(mime.get_mime_type("/nonexistent/image.png") ==
+            "application/octet-stream");
+
+    FILE *f = fopen((base + "globs2").c_str(), "w");
+    if (f == NULL)
+        SKIP("fopen: " << strerror(errno));
+    fputs("50:image/png:*.png\n", f);
+    fclose(f);
+    REQUIRE(mime.is_outdated());
+
+    SharedMimeInfo reloaded({base});
+    REQUIRE_FALSE(reloaded.is_outdated());
+    REQUIRE(reloaded.get_mime_type("/nonexistent/image.png") == "image/png");
+}
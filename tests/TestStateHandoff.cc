@@ -0,0 +1,119 @@
+//
+// This file is part of j4-dmenu-desktop.
+//
+// j4-dmenu-desktop is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// j4-dmenu-desktop is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with j4-dmenu-desktop.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "generated/tests_config.hh"
+
+#include "AppManager.hh"
+#include "LocaleSuffixes.hh"
+#include "StateHandoff.hh"
+
+using mapping_dump = std::map<std::string, std::pair<std::string, bool>>;
+
+static mapping_dump dump_mapping(const AppManager &appm) {
+    mapping_dump result;
+    for (const auto &[name, resolved] : appm.view_name_app_mapping())
+        result.emplace(name, std::make_pair(resolved.app->exec,
+                                            resolved.is_generic));
+    return result;
+}
+
+TEST_CASE("Test StateWriter and StateReader", "[StateHandoff]") {
+    StateWriter writer;
+    writer.write_int(-42);
+    writer.write_string("string");
+    writer.write_bool(true);
+    writer.write_string("");
+    writer.write_int(1LL << 40);
+
+    StateReader reader(writer.get_payload(), {});
+    REQUIRE(reader.read_int() == -42);
+    REQUIRE(reader.read_string() == "string");
+    REQUIRE(reader.read_bool());
+    REQUIRE(reader.read_string() == "");
+    REQUIRE(reader.read_int() == 1LL << 40);
+    REQUIRE_THROWS_AS(reader.read_int(), state_error);
+    REQUIRE_THROWS_AS(reader.read_bool(), state_error);
+}
+
+TEST_CASE("Test malformed state", "[StateHandoff]") {
+    SECTION("Invalid string length") {
+        StateWriter writer;
+        writer.write_int(1000);
+        writer.write_int(0);
+        StateReader reader(writer.get_payload(), {});
+        REQUIRE_THROWS_AS(reader.read_string(), state_error);
+    }
+
+    SECTION("Invalid file descriptor index") {
+        StateWriter writer;
+        writer.write_int(1);
+        StateReader reader(writer.get_payload(), {});
+        REQUIRE_THROWS_AS(reader.read_fd(), state_error);
+    }
+}
+
+TEST_CASE("Test AppManager state handoff", "[StateHandoff]") {
+    AppManager apps(
+        {
+            {TEST_FILES "a/applications/",
+             {TEST_FILES "a/applications/chromium.desktop",
+              TEST_FILES "a/applications/firefox.desktop",
+              TEST_FILES "a/applications/hidden.desktop"}},
+            {TEST_FILES "b/applications/",
+             {TEST_FILES "b/applications/chrome.desktop",
+              TEST_FILES "b/applications/safari.desktop"} },
+    },
+        {}, LocaleSuffixes("en_US"));
+
+    StateWriter writer;
+    apps.save_state(writer);
+
+    SECTION("Valid state") {
+        StateReader reader(writer.get_payload(), {});
+        AppManager restored(reader, {}, LocaleSuffixes("en_US"));
+
+        restored.check_inner_state();
+        // Disabled apps must be restored too, they take part in desktop file
+        // ID collisions.
+        REQUIRE(restored.count() == apps.count());
+        REQUIRE(dump_mapping(restored) == dump_mapping(apps));
+        REQUIRE(restored.lookup_by_ID("hidden.desktop").value().get() ==
+                apps.lookup_by_ID("hidden.desktop").value().get());
+
+        // The restored AppManager must behave the same way as the original
+        // one.
+        apps.remove(TEST_FILES "a/applications/firefox.desktop",
+                    TEST_FILES "a/applications/");
+        restored.remove(TEST_FILES "a/applications/firefox.desktop",
+                        TEST_FILES "a/applications/");
+        restored.check_inner_state();
+        REQUIRE(dump_mapping(restored) == dump_mapping(apps));
+    }
+
+    SECTION("Truncated state") {
+        const std::string &payload = writer.get_payload();
+        StateReader reader(payload.substr(0, payload.size() - 1), {});
+        REQUIRE_THROWS_AS(AppManager(reader, {}, LocaleSuffixes("en_US")),
+                          state_error);
+    }
+}
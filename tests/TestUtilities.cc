@@ -17,16 +17,19 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <iterator>
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
 // Used in setenv(), unsetenv()
 #include <stdlib.h> // IWYU pragma: keep
-// IWYU pragma: no_include <vector>
 
+#include "FSUtils.hh"
 #include "Utilities.hh"
 
 TEST_CASE("Test split()", "[Utilities]") {
@@ -97,6 +100,27 @@ TEST_CASE("Test get_variable()", "[Utilities]") {
     REQUIRE(get_variable("DOESNTEXIST") == "");
 }
 
+TEST_CASE("Test get_url_scheme()", "[Utilities]") {
+    REQUIRE(get_url_scheme("https://example.com") == "https");
+    REQUIRE(get_url_scheme("MAILTO:user@example.com") == "mailto");
+    REQUIRE(get_url_scheme("svn+ssh://host/repo") == "svn+ssh");
+    REQUIRE(get_url_scheme("/absolute/path").empty());
+    REQUIRE(get_url_scheme("relative/file:name").empty());
+    REQUIRE(get_url_scheme("1http://example.com").empty());
+    REQUIRE(get_url_scheme("noscheme").empty());
+}
+
+TEST_CASE("Test file_url_to_path()", "[Utilities]") {
+    REQUIRE(file_url_to_path("file:///home/user/a%20b.txt") ==
+            "/home/user/a b.txt");
+    REQUIRE(file_url_to_path("file://localhost/etc/fstab") == "/etc/fstab");
+    REQUIRE(file_url_to_path("FILE:///tmp/x#fragment") == "/tmp/x");
+    REQUIRE(file_url_to_path("file://otherhost/etc/fstab").empty());
+    REQUIRE(file_url_to_path("file:///bad%2").empty());
+    REQUIRE(file_url_to_path("file:///null%00byte").empty());
+    REQUIRE(file_url_to_path("https://example.com/").empty());
+}
+
 TEST_CASE("Test writen()", "[Utilities]") {
     int pipefd[2];
     if (pipe(pipefd) == -1)
@@ -122,3 +146,45 @@ TEST_CASE("Test writen()", "[Utilities]") {
         FAIL("Got too much data!");
     REQUIRE(errno == EWOULDBLOCK);
 }
+
+TEST_CASE("Test write_cache_file() and is_outdated()", "[Utilities]") {
+    char tmpdir[] = "/tmp/j4dd-utilities-unit-test-XXXXXX";
+    if (mkdtemp(tmpdir) == NULL)
+        SKIP("Couldn't mkdtemp(): " << strerror(errno));
+    OnExit rmdir = [&tmpdir]() { FSUtils::rmdir_recursive(tmpdir); };
+
+    std::string path = (std::string)tmpdir + "/cache";
+
+    std::vector<WatchedPath> watched;
+    watched.emplace_back(path);
+    REQUIRE_FALSE(watched.front().exists());
+    REQUIRE_FALSE(is_outdated(watched));
+
+    REQUIRE(write_cache_file(path, "test cache",
+                             [](FILE *file) { fputs("contents\n", file); }));
+    REQUIRE(is_outdated(watched));
+
+    watched.clear();
+    watched.emplace_back(path);
+    REQUIRE(watched.front().exists());
+    REQUIRE(watched.front().size == 9);
+    REQUIRE_FALSE(is_outdated(watched));
+
+    // The temporary file should have been renamed.
+    DIR *dir = opendir(tmpdir);
+    if (dir == NULL)
+        FAIL("Couldn't opendir(): " << strerror(errno));
+    int entries = 0;
+    while (readdir(dir) != NULL)
+        ++entries;
+    closedir(dir);
+    REQUIRE(entries == 3); // ".", ".." and the cache
+
+    REQUIRE(write_cache_file(path, "test cache", [](FILE *file) {
+        fputs("new contents\n", file);
+    }));
+    REQUIRE(is_outdated(watched));
+
+    REQUIRE_FALSE(write_cache_file((std::string)tmpdir + "/nonexistent/cache",
+                                   "test cache", [](FILE *) {}));
+}